@@ -0,0 +1,20 @@
+#!/bin/bash
+
+TOOL=../build/tools/alignment_tool
+TESTS=../tests
+MAX_THREADS=${1:-$(nproc)}
+
+INPUT=${INPUT:-$(mktemp)}
+if [ ! -s $INPUT ]; then
+    cat $TESTS/Human-Mouse-BRCA2-cds.fasta $TESTS/Opsin1_colorblindness_gene.fasta \
+        $TESTS/colorblind_human_gene.fasta $TESTS/colorblind_mouse_gene.fasta > $INPUT
+fi
+
+TIMEFORMAT="%R"
+
+for mode in -g -l; do
+    for t in $(seq 1 $MAX_THREADS); do
+        echo -n "$mode threads = $t time = "
+        { time $TOOL -i $INPUT -c $TESTS/config.json $mode --all-pairs --score-only -t $t > /dev/null; } 2>&1
+    done
+done
@@ -0,0 +1,15 @@
+#!/bin/bash
+
+TOOL=../build/tools/read_mapping_tool
+TESTS=../tests
+GENE=${GENE:-$TESTS/Peach_reference.fasta}
+READS=${READS:-$TESTS/Peach_simulated_reads.fasta}
+X=${1:-25}
+
+for aligner in full banded striped xdrop; do
+    for filter in "" --no-prefilter; do
+        echo "aligner = $aligner $filter"
+        $TOOL -g $GENE -r $READS -x $X --aligner $aligner $filter \
+            | grep -e "MapReads" -e "Prefilter"
+    done
+done
@@ -0,0 +1,16 @@
+#!/bin/bash
+
+TOOL=../build/tools/read_mapping_tool
+TESTS=../tests
+GENE=${GENE:-$TESTS/Peach_reference.fasta}
+READS=${READS:-$TESTS/Peach_simulated_reads.fasta}
+MAX_THREADS=${1:-$(nproc)}
+X=${2:-25}
+
+for aligner in striped batched; do
+    for t in $(seq 1 $MAX_THREADS); do
+        echo -n "aligner = $aligner threads = $t "
+        $TOOL -g $GENE -r $READS -x $X --aligner $aligner -t $t \
+            | grep -e "MapReads"
+    done
+done
@@ -0,0 +1,15 @@
+#!/bin/bash
+
+TOOL=../build/tools/alignment_tool
+TESTS=../tests
+INPUT=${INPUT:-$TESTS/Human-Mouse-BRCA2-cds.fasta}
+MAX_THREADS=${1:-$(nproc)}
+
+TIMEFORMAT="%R"
+
+for mode in -g -l; do
+    for t in $(seq 1 $MAX_THREADS); do
+        echo -n "$mode threads = $t time = "
+        { time $TOOL -i $INPUT -c $TESTS/config.json $mode -m 100000 -t $t > /dev/null; } 2>&1
+    done
+done
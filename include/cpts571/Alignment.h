@@ -18,41 +18,221 @@
 
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
 #include <iomanip>
+#include <iterator>
+#include <limits>
 #include <memory>
-#include <deque>
+#include <string>
 #include <tuple>
+#include <vector>
 
+#include "cpts571/Cigar.h"
 #include "cpts571/Sequence.h"
+#include "cpts571/SubstitutionMatrix.h"
 
 #ifndef _ALIGNMENT_H_
 #define _ALIGNMENT_H_
 
 namespace cpts571 {
 
-//! \brief Possible actions during alignment
-enum class Action {
-  Match,
-  Mismatch,
-  Insertion,
-  Deletion,
-  DC_MatchMismatch, //< This is a don't care action needed for the print routine
-  DC_Insertion,     //< This is a don't care action needed for the print routine
-  DC_Deletion       //< This is a don't care action needed for the print routine
+//! \brief The score table used by the affine score function
+//!
+//! When a substitution matrix is given, it replaces the match and mismatch
+//! scores in the scores of the pairs of characters.
+struct ScoreTable {
+  ssize_t Match;
+  ssize_t Mismatch;
+  ssize_t H;
+  ssize_t G;
+  std::shared_ptr<const SubstitutionMatrix> Substitution;
+
+  //! \brief The score of aligning a to b.
+  ssize_t Score(char a, char b) const {
+    if (Substitution) return Substitution->Score(a, b);
+    return a == b ? Match : Mismatch;
+  }
+
+  //! \brief The lowest score of a pair of characters.
+  ssize_t MinScore() const {
+    return Substitution ? Substitution->MinScore() : std::min(Match, Mismatch);
+  }
+
+  //! \brief The highest score of a pair of characters.
+  ssize_t MaxScore() const {
+    return Substitution ? Substitution->MaxScore() : std::max(Match, Mismatch);
+  }
+};
+
+//! \brief The scores of every character against the positions of a query.
+//!
+//! The scores are computed once per query, so that filling a row of the table
+//! reads the row of the character of s1 and then one score per cell.  The
+//! characters scoring the same against every position, those outside both the
+//! query and the substitution matrix, share the first row.
+class ScoreProfile {
+ public:
+  using ScoreTy = int32_t;
+
+  //! \brief Constructor
+  //! \param B The beginning of the query
+  //! \param E The end of the query
+  //! \param S The score table
+  template <typename Iterator>
+  ScoreProfile(Iterator B, Iterator E, const ScoreTable & S)
+      : length_(std::distance(B, E)), symbols_(1, '\0') {
+    index_.fill(0);
+    auto add = [&](char c) {
+      if (index_[uint8_t(c)] != 0 || c == '\0') return;
+      index_[uint8_t(c)] = symbols_.size();
+      symbols_.push_back(c);
+    };
+    for (auto itr = B; itr != E; ++itr) add(*itr);
+    if (S.Substitution)
+      for (auto c : S.Substitution->Alphabet()) add(c);
+
+    scores_.resize(symbols_.size() * length_);
+    for (size_t c = 0; c < symbols_.size(); ++c) {
+      size_t j = 0;
+      for (auto itr = B; itr != E; ++itr, ++j)
+        scores_[c * length_ + j] = S.Score(symbols_[c], *itr);
+    }
+
+    minScore_ = S.MinScore();
+    maxScore_ = S.MaxScore();
+    if (!scores_.empty()) {
+      minScore_ = *std::min_element(scores_.begin(), scores_.end());
+      maxScore_ = *std::max_element(scores_.begin(), scores_.end());
+    }
+  }
+
+  //! \brief Constructor
+  //! \param query The query
+  //! \param S The score table
+  ScoreProfile(const Sequence & query, const ScoreTable & S)
+      : ScoreProfile(query.begin(), query.end(), S) {}
+
+  //! \brief Return the length of the query
+  size_t length() const { return length_; }
+
+  //! \brief The number of rows of the profile.
+  size_t Symbols() const { return symbols_.size(); }
+
+  //! \brief The character of the row c, '\0' for the shared row.
+  char Symbol(size_t c) const { return symbols_[c]; }
+
+  //! \brief The row of the profile used for the character c.
+  size_t Index(char c) const { return index_[uint8_t(c)]; }
+
+  //! \brief The scores of the character c against the query.
+  const ScoreTy * Row(char c) const {
+    return scores_.data() + Index(c) * length_;
+  }
+
+  //! \brief The lowest score of the profile.
+  ssize_t MinScore() const { return minScore_; }
+
+  //! \brief The highest score of the profile.
+  ssize_t MaxScore() const { return maxScore_; }
+
+ private:
+  size_t length_;
+  std::string symbols_;
+  std::array<uint32_t, 256> index_;
+  std::vector<ScoreTy> scores_;
+  ssize_t minScore_;
+  ssize_t maxScore_;
+};
+
+//! \brief Properties of the type storing the scores in the table.
+//!
+//! Minus infinity is a sentinel far enough from the lower limit of Score that
+//! adding the scores of a ScoreTable to it never wraps around.  Scores below
+//! the sentinel saturate to it, so that minus infinity stays minus infinity.
+template <typename Score>
+struct ScoreTraits {
+  static constexpr Score NegativeInfinity() {
+    return std::numeric_limits<Score>::min() / 2;
+  }
+
+  static Score Saturate(ssize_t score) {
+    return score < NegativeInfinity() ? NegativeInfinity() : Score(score);
+  }
+
+  //! \brief Check if Score holds every score of a rows x columns table.
+  //!
+  //! A cell is reached from (0,0) in at most rows + columns steps, each one
+  //! changing the score by at most the sum of the absolute values of the
+  //! lowest and highest pair scores, H and G.  Scores must also stay one step
+  //! away from the sentinel.
+  static bool Fits(size_t rows, size_t columns, const ScoreTable & S) {
+    ssize_t step = std::abs(S.MinScore()) + std::abs(S.MaxScore()) +
+                   std::abs(S.H) + std::abs(S.G);
+    if (step == 0) return true;
+    return rows + columns + 2 <=
+        size_t(std::numeric_limits<Score>::max() / 2 / step);
+  }
 };
 
+//! \brief Call f with a value of the narrowest score type holding the scores
+//! of a rows x columns table.
+template <typename F>
+auto DispatchScoreType(size_t rows, size_t columns, const ScoreTable & S,
+                       F && f) -> decltype(f(ssize_t())) {
+  if (ScoreTraits<int16_t>::Fits(rows, columns, S)) return f(int16_t());
+  if (ScoreTraits<int32_t>::Fits(rows, columns, S)) return f(int32_t());
+  return f(ssize_t());
+}
 
 //! \brief The cell of the matrix used for the alignment procedure
-struct AffineCell {
-  ssize_t Match;
-  ssize_t Insertion;
-  ssize_t Deletion;
+//! \tparam Score The type of the scores.
+template <typename Score>
+struct BasicAffineCell {
+  using ScoreTy = Score;
+
+  Score Match;
+  Score Insertion;
+  Score Deletion;
 };
 
+using AffineCell = BasicAffineCell<ssize_t>;
+
+//! \brief Reference to a cell of a table stored as structure of arrays.
+template <typename Score>
+struct AffineCellRef {
+  using ScoreTy = Score;
+
+  Score & Match;
+  Score & Insertion;
+  Score & Deletion;
+
+  AffineCellRef & operator=(const BasicAffineCell<Score> & cell) {
+    Match = cell.Match;
+    Insertion = cell.Insertion;
+    Deletion = cell.Deletion;
+    return *this;
+  }
+
+  AffineCellRef & operator=(const AffineCellRef & cell) {
+    return *this = BasicAffineCell<Score>(cell);
+  }
+
+  operator BasicAffineCell<Score>() const {
+    return BasicAffineCell<Score>{ Match, Insertion, Deletion };
+  }
+};
+
+//! \brief Tags selecting the memory layout of the dynamic programming table.
+struct array_of_structs_tag {};
+struct struct_of_arrays_tag {};
+
 //! \brief The Matrix used for the dynamic programming table
 //! \tparam Cell The type of the cell in the table.
-template <typename Cell>
+//! \tparam Layout The memory layout of the table.
+template <typename Cell, typename Layout = array_of_structs_tag>
 class Matrix {
  public:
   using CellTy = Cell;
@@ -100,19 +280,91 @@ class Matrix {
   CellTy ** matrix_;
 };
 
+//! \brief Dynamic programming table keeping only the last two rows.
+//!
+//! Row i and row i - 1 are the only ones accessed while computing row i, so
+//! the logical rows of the table are mapped on two physical rows.
+//! \tparam Cell The type of the cell in the table.
+template <typename Cell>
+class RollingMatrix {
+ public:
+  using CellTy = Cell;
+
+  //! \brief Constructor
+  //! \param rows Number of logical rows
+  //! \param columns Number of columns
+  RollingMatrix(size_t rows, size_t columns)
+      : rows_(rows), columns_(columns), matrix_(new CellTy[2 * columns]) {}
+
+  //! \brief Return the number of logical rows of the matrix
+  size_t rows() const { return rows_; }
+
+  //! \brief Return the number of columns of the matrix
+  size_t columns() const { return columns_; }
+
+  //! \brief Get the cell (i,j) of the matrix
+  CellTy & operator()(size_t row, size_t column) const {
+    return matrix_[(row & 1) * columns_ + column];
+  }
+
+ private:
+  size_t rows_;
+  size_t columns_;
+  std::unique_ptr<CellTy[]> matrix_;
+};
+
+//! \brief The Matrix storing the three scores of the cells in three planes.
+//!
+//! A cell is accessed through an AffineCellRef, so that the recurrences read
+//! and write it as they do with the array of structs layout.
+//! \tparam Score The type of the scores.
+template <typename Score>
+class Matrix<BasicAffineCell<Score>, struct_of_arrays_tag> {
+ public:
+  using CellTy = BasicAffineCell<Score>;
+
+  //! \brief Constructor
+  //! \param rows Number of rows
+  //! \param columns Number of columns
+  Matrix(size_t rows, size_t columns)
+      : rows_(rows), columns_(columns), size_(rows * columns)
+      , planes_(new Score[3 * size_]) {}
+
+  //! \brief Return the number of rows of the matrix
+  size_t rows() const { return rows_; }
+
+  //! \brief Return the number of columns of the matrix
+  size_t columns() const { return columns_; }
+
+  //! \brief Get the cell (i,j) of the matrix
+  AffineCellRef<Score> operator()(size_t row, size_t column) const {
+    size_t k = row * columns_ + column;
+    return AffineCellRef<Score>{
+      planes_[k], planes_[size_ + k], planes_[2 * size_ + k] };
+  }
+
+ private:
+  size_t rows_;
+  size_t columns_;
+  size_t size_;
+  std::unique_ptr<Score[]> planes_;
+};
+
 struct global_alignment_tag {};
 struct local_alignment_tag {};
 
-//! \brief The score table used by the affine score function
-struct ScoreTable {
-  ssize_t Match;
-  ssize_t Mismatch;
-  ssize_t H;
-  ssize_t G;
-};
+//! \brief Alignment of the whole s2 to a substring of s1.
+//!
+//! The gaps of s1 before and after the alignment are free, so s2 (the read)
+//! is placed end to end on s1 (the reference).
+struct semiglobal_alignment_tag {};
 
 //! \brief The Algorithm Trait of the Sequence alignment
-template <typename T>
+//! \tparam T The algorithm tag.
+//! \tparam Score The type of the scores stored in the table.
+//! \tparam Layout The memory layout of the table.
+template <typename T, typename Score = ssize_t,
+          typename Layout = array_of_structs_tag>
 class AlignmentAlgorithmTrait {
  public:
   using CellTy   = ssize_t;
@@ -121,159 +373,233 @@ class AlignmentAlgorithmTrait {
   //! \brief Inizialization step
   static void InitializeMatrix(const ScoreTable & S, const MatrixTy & M);
 
+  //! \brief Inizialization of the boundary cells of the row i.
+  template <typename MatrixT>
+  static void InitializeRow(const ScoreTable & S, const MatrixT & M, size_t i);
+
+  //! \brief The content of the boundary cell (i,j), with i == 0 or j == 0.
+  static CellTy BoundaryCell(const ScoreTable & S, size_t i, size_t j);
+
   //! \brief The function computing the score
+  //!
+  //! \param score The score of aligning s1[i - 1] to s2[j - 1]
+  template <typename MatrixT>
   static void ComputeScore(
       const ScoreTable & S,
-      const MatrixTy & M, const size_t i, const size_t j,
-      const char s1, const char s2);
+      const MatrixT & M, const size_t i, const size_t j, const ssize_t score);
+
+  //! \brief Keep track of the best score seen during the fill.
+  template <typename MatrixT>
+  static void UpdateBestScore(
+      const MatrixT & M, const size_t i, const size_t j,
+      std::tuple<size_t, size_t, ssize_t> & best);
+
+  //! \brief retrieve the final score once the cell (i,j) has been filled.
+  template <typename MatrixT>
+  static std::tuple<size_t, size_t, ssize_t>
+  GetFinalScore(
+      const MatrixT & M, const size_t i, const size_t j,
+      const std::tuple<size_t, size_t, ssize_t> & best);
 
   //! \brief retrieve the content of the final cell.
+  template <typename MatrixT>
   static std::tuple<size_t, size_t, ssize_t, Action>
   GetFinalScoreAndAction(
-      const MatrixTy & M, const Sequence & s1, const Sequence& s2);
+      const MatrixT & M, const Sequence & s1, const Sequence& s2,
+      const std::tuple<size_t, size_t, ssize_t> & best);
 
   //! \brief condition to stop the traceback rutine
+  template <typename MatrixT>
   static bool
-  TraceBackStopCondition(const MatrixTy & M, const size_t i, const size_t j);
+  TraceBackStopCondition(const MatrixT & M, const size_t i, const size_t j);
+
+  //! \brief condition to stop the traceback rutine before entering the match
+  //! state of the cell (i,j).
+  template <typename MatrixT>
+  static bool
+  TraceBackStartCondition(const MatrixT & M, const size_t i, const size_t j);
 };
 
 
 //! \brief Specialization of the trait for the local alignment
-template <>
-class AlignmentAlgorithmTrait<local_alignment_tag> {
+template <typename Score, typename Layout>
+class AlignmentAlgorithmTrait<local_alignment_tag, Score, Layout> {
  public:
-  using CellTy   = AffineCell;
-  using MatrixTy = Matrix<CellTy>;
+  using CellTy   = BasicAffineCell<Score>;
+  using MatrixTy = Matrix<CellTy, Layout>;
 
   static void InitializeMatrix(const ScoreTable & S, const MatrixTy & M) {
-    M(0,0).Match     = 0;
-    M(0,0).Insertion = std::numeric_limits<ssize_t>::min();
-    M(0,0).Deletion  = std::numeric_limits<ssize_t>::min();
-
-    for (size_t i = 1; i < M.rows(); ++i) {
-      M(i, 0).Match     = std::numeric_limits<ssize_t>::min();
-      M(i, 0).Deletion  = 0;
-      M(i, 0).Insertion = std::numeric_limits<ssize_t>::min();
-    }
-    for (size_t j = 1; j < M.columns(); ++j) {
-      M(0, j).Match     = std::numeric_limits<ssize_t>::min();
-      M(0, j).Deletion  = std::numeric_limits<ssize_t>::min();
-      M(0, j).Insertion = 0;
+    for (size_t i = 0; i < M.rows(); ++i)
+      InitializeRow(S, M, i);
+  }
+
+  template <typename MatrixT>
+  static void InitializeRow(const ScoreTable & S, const MatrixT & M, size_t i) {
+    if (i != 0) {
+      M(i, 0) = BoundaryCell(S, i, 0);
+      return;
     }
+
+    for (size_t j = 0; j < M.columns(); ++j)
+      M(0, j) = BoundaryCell(S, 0, j);
   }
 
+  static CellTy BoundaryCell(const ScoreTable &, size_t i, size_t j) {
+    const Score inf = ScoreTraits<Score>::NegativeInfinity();
+    CellTy cell;
+    cell.Match     = i == 0 && j == 0 ? 0 : inf;
+    cell.Insertion = i == 0 && j != 0 ? 0 : inf;
+    cell.Deletion  = i != 0 && j == 0 ? 0 : inf;
+    return cell;
+  }
+
+  template <typename MatrixT>
   static void ComputeScore(
       const ScoreTable & S,
-      const MatrixTy & M, const size_t i, const size_t j,
-      const char s1, const char s2) {
-    ssize_t matchOrMismatch = s1 == s2 ? S.Match : S.Mismatch;
-    M(i,j).Match =
-        std::max(ssize_t(0),
-                 std::max(M(i - 1, j - 1).Match,
-                          std::max(M(i - 1, j - 1).Deletion,
-                                   M(i - 1, j - 1).Insertion))
-                 + matchOrMismatch);
-
-    auto getNewScore = [](ssize_t current, ssize_t delta) -> ssize_t {
-      if (current == std::numeric_limits<ssize_t>::min())
-        return current;
-
-      return current + delta;
-    };
+      const MatrixT & M, const size_t i, const size_t j, const ssize_t score) {
+    using Traits = ScoreTraits<typename MatrixT::CellTy::ScoreTy>;
+    const auto diagonal = M(i - 1, j - 1);
+    const auto up = M(i - 1, j);
+    const auto left = M(i, j - 1);
+    auto && cell = M(i, j);
+
+    cell.Match = std::max<ssize_t>(
+        0,
+        std::max<ssize_t>({ diagonal.Match, diagonal.Deletion,
+                            diagonal.Insertion }) + score);
+
+    cell.Deletion = Traits::Saturate(
+        std::max<ssize_t>({ up.Match + S.G + S.H,
+                            up.Deletion + S.G,
+                            up.Insertion + S.G + S.H }));
+
+    cell.Insertion = Traits::Saturate(
+        std::max<ssize_t>({ left.Match + S.G + S.H,
+                            left.Deletion + S.G + S.H,
+                            left.Insertion + S.G }));
+  }
 
-    M(i,j).Deletion =
-        std::max(getNewScore(M(i - 1, j).Match, S.G + S.H),
-                 std::max(
-                     getNewScore(M(i - 1, j).Deletion, S.G),
-                     getNewScore(M(i - 1, j).Insertion, S.G + S.H)));
+  template <typename MatrixT>
+  static void UpdateBestScore(
+      const MatrixT & M, const size_t i, const size_t j,
+      std::tuple<size_t, size_t, ssize_t> & best) {
+    if (M(i,j).Match > std::get<2>(best))
+      best = std::make_tuple(i, j, M(i,j).Match);
+  }
 
-    M(i,j).Insertion =
-        std::max(getNewScore(M(i, j - 1).Match, S.G + S.H),
-                 std::max(
-                     getNewScore(M(i, j - 1).Deletion, S.G + S.H),
-                     getNewScore(M(i, j - 1).Insertion, S.G)));
+  template <typename MatrixT>
+  static std::tuple<size_t, size_t, ssize_t>
+  GetFinalScore(
+      const MatrixT &, const size_t, const size_t,
+      const std::tuple<size_t, size_t, ssize_t> & best) {
+    return best;
   }
 
+  template <typename MatrixT>
   static std::tuple<size_t, size_t, ssize_t, Action>
   GetFinalScoreAndAction(
-      const MatrixTy & M, const Sequence & s1, const Sequence& s2) {
-    ssize_t maxScore = 0;
-    size_t maxI, maxJ;
-    for (size_t i = 0; i < M.rows(); ++i) {
-      for (size_t j = 0; j < M.columns(); ++j) {
-        if (M(i,j).Match > maxScore) {
-          maxI = i;
-          maxJ = j;
-          maxScore = M(i,j).Match;
-        }
-      }
-    }
-    return std::make_tuple(maxI, maxJ, maxScore, Action::Match);
-  }  
+      const MatrixT &, const Sequence & s1, const Sequence & s2,
+      const std::tuple<size_t, size_t, ssize_t> & best) {
+    size_t i = std::get<0>(best), j = std::get<1>(best);
+    // With a substitution matrix different characters may score positive.
+    Action action = i == 0 || j == 0 || s1[i - 1] == s2[j - 1]
+        ? Action::Match : Action::Mismatch;
+    return std::tuple_cat(best, std::make_tuple(action));
+  }
+
+  template <typename MatrixT>
+  static bool
+  TraceBackStopCondition(const MatrixT &, const size_t i, const size_t j) {
+    return i == 0 || j == 0;
+  }
 
+  //! A gap may still reach a cell whose match score is zero, so only the
+  //! match state of the cell starts the alignment.
+  template <typename MatrixT>
   static bool
-  TraceBackStopCondition(const MatrixTy & M, const size_t i, const size_t j) {
-    return i == 0 || j == 0 || M(i,j).Match == 0;
+  TraceBackStartCondition(const MatrixT & M, const size_t i, const size_t j) {
+    return M(i,j).Match == 0;
   }
 };
 
 
 //! \brief Specialization of the trait for the global alignment
-template <>
-class AlignmentAlgorithmTrait<global_alignment_tag> {
+template <typename Score, typename Layout>
+class AlignmentAlgorithmTrait<global_alignment_tag, Score, Layout> {
  public:
-  using CellTy   = AffineCell;
-  using MatrixTy = Matrix<CellTy>;
+  using CellTy   = BasicAffineCell<Score>;
+  using MatrixTy = Matrix<CellTy, Layout>;
 
   static void InitializeMatrix(const ScoreTable & S, const MatrixTy & M) {
-    M(0,0).Match     = 0;
-    M(0,0).Insertion = std::numeric_limits<ssize_t>::min();
-    M(0,0).Deletion  = std::numeric_limits<ssize_t>::min();
-
-    for (size_t i = 1; i < M.rows(); ++i) {
-      M(i, 0).Match     = std::numeric_limits<ssize_t>::min();
-      M(i, 0).Deletion  = S.H + i * S.G;
-      M(i, 0).Insertion = std::numeric_limits<ssize_t>::min();
-    }
-    for (size_t j = 1; j < M.columns(); ++j) {
-      M(0, j).Match     = std::numeric_limits<ssize_t>::min();
-      M(0, j).Deletion  = std::numeric_limits<ssize_t>::min();
-      M(0, j).Insertion =  S.H + j * S.G;
+    for (size_t i = 0; i < M.rows(); ++i)
+      InitializeRow(S, M, i);
+  }
+
+  template <typename MatrixT>
+  static void InitializeRow(const ScoreTable & S, const MatrixT & M, size_t i) {
+    if (i != 0) {
+      M(i, 0) = BoundaryCell(S, i, 0);
+      return;
     }
+
+    for (size_t j = 0; j < M.columns(); ++j)
+      M(0, j) = BoundaryCell(S, 0, j);
   }
 
-  static void ComputeScore(
-      const ScoreTable & S, const MatrixTy & M, const size_t i, const size_t j,
-      const char s1, const char s2) {
-    ssize_t matchOrMismatch = s1 == s2 ? S.Match : S.Mismatch;
-    M(i,j).Match =
-        std::max(M(i - 1, j - 1).Match,
-                 std::max(M(i - 1, j - 1).Deletion, M(i - 1, j - 1).Insertion))
-        + matchOrMismatch;
-
-    auto getNewScore = [](ssize_t current, ssize_t delta) -> ssize_t {
-      if (current == std::numeric_limits<ssize_t>::min())
-        return current;
-
-      return current + delta;
-    };
+  static CellTy BoundaryCell(const ScoreTable & S, size_t i, size_t j) {
+    const Score inf = ScoreTraits<Score>::NegativeInfinity();
+    CellTy cell;
+    cell.Match     = i == 0 && j == 0 ? 0 : inf;
+    cell.Insertion = i == 0 && j != 0 ? Score(S.H + ssize_t(j) * S.G) : inf;
+    cell.Deletion  = i != 0 && j == 0 ? Score(S.H + ssize_t(i) * S.G) : inf;
+    return cell;
+  }
 
-    M(i,j).Deletion =
-        std::max(getNewScore(M(i - 1, j).Match, S.G + S.H),
-                 std::max(
-                     getNewScore(M(i - 1, j).Deletion, S.G),
-                     getNewScore(M(i - 1, j).Insertion, S.G + S.H)));
+  template <typename MatrixT>
+  static void ComputeScore(
+      const ScoreTable & S, const MatrixT & M, const size_t i, const size_t j,
+      const ssize_t score) {
+    using Traits = ScoreTraits<typename MatrixT::CellTy::ScoreTy>;
+    const auto diagonal = M(i - 1, j - 1);
+    const auto up = M(i - 1, j);
+    const auto left = M(i, j - 1);
+    auto && cell = M(i, j);
+
+    cell.Match = Traits::Saturate(
+        std::max<ssize_t>({ diagonal.Match, diagonal.Deletion,
+                            diagonal.Insertion }) + score);
+
+    cell.Deletion = Traits::Saturate(
+        std::max<ssize_t>({ up.Match + S.G + S.H,
+                            up.Deletion + S.G,
+                            up.Insertion + S.G + S.H }));
+
+    cell.Insertion = Traits::Saturate(
+        std::max<ssize_t>({ left.Match + S.G + S.H,
+                            left.Deletion + S.G + S.H,
+                            left.Insertion + S.G }));
+  }
 
-    M(i,j).Insertion =
-        std::max(getNewScore(M(i, j - 1).Match, S.G + S.H),
-                 std::max(
-                     getNewScore(M(i, j - 1).Deletion, S.G + S.H),
-                     getNewScore(M(i, j - 1).Insertion, S.G)));
+  template <typename MatrixT>
+  static void UpdateBestScore(
+      const MatrixT &, const size_t, const size_t,
+      std::tuple<size_t, size_t, ssize_t> &) {}
+
+  template <typename MatrixT>
+  static std::tuple<size_t, size_t, ssize_t>
+  GetFinalScore(
+      const MatrixT & M, const size_t i, const size_t j,
+      const std::tuple<size_t, size_t, ssize_t> &) {
+    auto cell = M(i, j);
+    return std::make_tuple(
+        i, j, std::max(cell.Match, std::max(cell.Deletion, cell.Insertion)));
   }
 
+  template <typename MatrixT>
   static std::tuple<size_t, size_t, ssize_t, Action>
   GetFinalScoreAndAction(
-      const MatrixTy & M, const Sequence & s1, const Sequence& s2) {
+      const MatrixT & M, const Sequence & s1, const Sequence& s2,
+      const std::tuple<size_t, size_t, ssize_t> &) {
     auto cell = M(M.rows() - 1, M.columns() - 1);
     Action action =
         s1[s1.length() - 1] == s2[s2.length() - 1]
@@ -294,21 +620,131 @@ class AlignmentAlgorithmTrait<global_alignment_tag> {
     return std::make_tuple(M.rows() - 1, M.columns() - 1, score, action);
   }
 
+  template <typename MatrixT>
   static bool
-  TraceBackStopCondition(const MatrixTy &, const size_t i, const size_t j) {
+  TraceBackStopCondition(const MatrixT &, const size_t i, const size_t j) {
     return (i == 0 && j == 0);
   }
+
+  template <typename MatrixT>
+  static bool
+  TraceBackStartCondition(const MatrixT &, const size_t, const size_t) {
+    return false;
+  }
 };
 
-template <typename algorithm_tag>
-std::tuple<std::deque<Action>, size_t, size_t>
+//! \brief Specialization of the trait for the semi-global alignment
+template <typename Score, typename Layout>
+class AlignmentAlgorithmTrait<semiglobal_alignment_tag, Score, Layout> {
+ public:
+  using CellTy   = BasicAffineCell<Score>;
+  using MatrixTy = Matrix<CellTy, Layout>;
+
+  static void InitializeMatrix(const ScoreTable & S, const MatrixTy & M) {
+    for (size_t i = 0; i < M.rows(); ++i)
+      InitializeRow(S, M, i);
+  }
+
+  template <typename MatrixT>
+  static void InitializeRow(const ScoreTable & S, const MatrixT & M, size_t i) {
+    if (i != 0) {
+      M(i, 0) = BoundaryCell(S, i, 0);
+      return;
+    }
+
+    for (size_t j = 0; j < M.columns(); ++j)
+      M(0, j) = BoundaryCell(S, 0, j);
+  }
+
+  //! The alignment may start on any row of the first column.
+  static CellTy BoundaryCell(const ScoreTable & S, size_t i, size_t j) {
+    const Score inf = ScoreTraits<Score>::NegativeInfinity();
+    CellTy cell;
+    cell.Match     = j == 0 ? 0 : inf;
+    cell.Insertion = i == 0 && j != 0 ? Score(S.H + ssize_t(j) * S.G) : inf;
+    cell.Deletion  = inf;
+    return cell;
+  }
+
+  template <typename MatrixT>
+  static void ComputeScore(
+      const ScoreTable & S, const MatrixT & M, const size_t i, const size_t j,
+      const ssize_t score) {
+    AlignmentAlgorithmTrait<global_alignment_tag, Score, Layout>::ComputeScore(
+        S, M, i, j, score);
+  }
+
+  //! The alignment may end on any row of the last column, so only those
+  //! cells are compared.  The first row of the last column replaces the
+  //! initial best score, since the optimal score may be negative.
+  template <typename MatrixT>
+  static void UpdateBestScore(
+      const MatrixT & M, const size_t i, const size_t j,
+      std::tuple<size_t, size_t, ssize_t> & best) {
+    if (j + 1 != M.columns()) return;
+
+    auto cell = M(i, j);
+    ssize_t score =
+        std::max<ssize_t>({ cell.Match, cell.Insertion, cell.Deletion });
+    if (i == 1 || score > std::get<2>(best))
+      best = std::make_tuple(i, j, score);
+  }
+
+  template <typename MatrixT>
+  static std::tuple<size_t, size_t, ssize_t>
+  GetFinalScore(
+      const MatrixT &, const size_t, const size_t,
+      const std::tuple<size_t, size_t, ssize_t> & best) {
+    return best;
+  }
+
+  template <typename MatrixT>
+  static std::tuple<size_t, size_t, ssize_t, Action>
+  GetFinalScoreAndAction(
+      const MatrixT & M, const Sequence & s1, const Sequence & s2,
+      const std::tuple<size_t, size_t, ssize_t> & best) {
+    size_t i = std::get<0>(best), j = std::get<1>(best);
+    ssize_t score = std::get<2>(best);
+    auto cell = M(i, j);
+
+    Action action = Action::Deletion;
+    if (cell.Match == score)
+      action = i == 0 || j == 0 || s1[i - 1] == s2[j - 1]
+          ? Action::Match : Action::Mismatch;
+    else if (cell.Insertion == score)
+      action = Action::Insertion;
+
+    return std::tuple_cat(best, std::make_tuple(action));
+  }
+
+  template <typename MatrixT>
+  static bool
+  TraceBackStopCondition(const MatrixT &, const size_t, const size_t j) {
+    return j == 0;
+  }
+
+  template <typename MatrixT>
+  static bool
+  TraceBackStartCondition(const MatrixT &, const size_t, const size_t) {
+    return false;
+  }
+};
+
+template <typename algorithm_tag,
+          typename MatrixT =
+              typename AlignmentAlgorithmTrait<algorithm_tag>::MatrixTy>
+std::tuple<Cigar, size_t, size_t>
 TraceBackActions(
-    const typename AlignmentAlgorithmTrait<algorithm_tag>::MatrixTy & M,
+    const MatrixT & M,
     size_t i, size_t j, Action action, ssize_t score,
     const ScoreTable & S, const Sequence & s1, const Sequence & s2) {
   using AlgorithmTrait = AlignmentAlgorithmTrait<algorithm_tag>;
 
-  std::deque<Action> actionStack;
+  Cigar actionStack;
+  // A local alignment without a positive score starts and ends at (0,0).
+  if (AlgorithmTrait::TraceBackStopCondition(M, i, j))
+    return std::make_tuple(actionStack, i, j);
+
   actionStack.push_back(action);
 
   switch (action) {
@@ -326,44 +762,40 @@ TraceBackActions(
       break;
   }
 
+  bool start = false;
   while (!AlgorithmTrait::TraceBackStopCondition(M, i, j)) {
     switch(action) {
       case Action::Match:
-        if (M(i,j).Match + S.Match == score) {
+      case Action::Mismatch: {
+        // The score of the characters aligned by the step just taken.
+        ssize_t pair = S.Score(s1[i], s2[j]);
+        if (M(i,j).Match + pair == score) {
+          if (AlgorithmTrait::TraceBackStartCondition(M, i, j)) {
+            start = true;
+            break;
+          }
           action = s1[i - 1] == s2[j - 1] ? Action::Match : Action::Mismatch;
           score  = M(i,j).Match;
           --i; --j;
-        } else if (M(i,j).Insertion + S.Match == score) {
+        } else if (M(i,j).Insertion + pair == score) {
           action = Action::Insertion;
           score  = M(i,j).Insertion;
           --j;
-        } else if (M(i,j).Deletion + S.Match == score) {
+        } else if (M(i,j).Deletion + pair == score) {
           action = Action::Deletion;
           score  = M(i,j).Deletion;
           --i;
         } else {
-          exit(-1);
-        }
-        break;
-      case Action::Mismatch:
-        if (M(i,j).Match + S.Mismatch == score) {
-          action = s1[i - 1] == s2[j - 1] ? Action::Match : Action::Mismatch;
-          score  = M(i,j).Match;
-          --i; --j;
-        } else if (M(i,j).Insertion + S.Mismatch == score) {
-          action = Action::Insertion;
-          score  = M(i,j).Insertion;
-          --j;
-        } else if (M(i,j).Deletion + S.Mismatch == score) {
-          action = Action::Deletion;
-          score  = M(i,j).Deletion;
-          --i;
-        } else {
-          exit(-2);
+          exit(action == Action::Match ? -1 : -2);
         }
         break;
+      }
       case Action::Insertion:
         if (M(i,j).Match + S.H + S.G == score) {
+          if (AlgorithmTrait::TraceBackStartCondition(M, i, j)) {
+            start = true;
+            break;
+          }
           action = s1[i - 1] == s2[j - 1] ? Action::Match : Action::Mismatch;
           score  = M(i,j).Match;
           --i; --j;
@@ -381,6 +813,10 @@ TraceBackActions(
         break;
       case Action::Deletion:
         if (M(i,j).Match + S.H + S.G == score) {
+          if (AlgorithmTrait::TraceBackStartCondition(M, i, j)) {
+            start = true;
+            break;
+          }
           action = s1[i - 1] == s2[j - 1] ? Action::Match : Action::Mismatch;
           score  = M(i,j).Match;
           --i; --j;
@@ -400,33 +836,65 @@ TraceBackActions(
         break;
     }
 
+    if (start) break;
     actionStack.push_back(action);
   }
 
   return std::make_tuple(actionStack, i, j);
 }
 
-//! \brief The alignment procedure.
+//! \brief The score of the alignment of s1 and s2.
+inline ssize_t
+AlignmentScore(const Cigar & cigar, const Sequence & s1, const Sequence & s2,
+               const ScoreTable & S) {
+  ssize_t score = S.H * cigar.openingGaps() + S.G * cigar.gaps();
+  size_t i = cigar.begin1(), j = cigar.begin2();
+  for (auto itr = cigar.runs().rbegin(), end = cigar.runs().rend();
+       itr != end; ++itr) {
+    switch (itr->action) {
+      case Action::Match:
+      case Action::Mismatch:
+        for (size_t k = 0; k < itr->length; ++k)
+          score += S.Score(s1[i++], s2[j++]);
+        break;
+      case Action::Insertion:
+        j += itr->length;
+        break;
+      case Action::Deletion:
+        i += itr->length;
+        break;
+      default:
+        break;
+    }
+  }
+  return score;
+}
+
+//! \brief The alignment procedure on a table of the given score type and
+//! layout.
 //!
 //! \param s1 The first sequence
 //! \param s2 The second sequence
 //! \param S  The score table
-//! \returns The list of action needed to alingn s1 to s2
-template <typename algorithm_tag>
-std::deque<Action>
-Alignment(const Sequence &s1, const Sequence &s2,
-          ScoreTable &S, const algorithm_tag &) {
+//! \returns The alignment of s1 and s2
+template <typename algorithm_tag, typename Score, typename Layout>
+Cigar
+BasicAlignment(const Sequence &s1, const Sequence &s2, const ScoreTable &S) {
   // Initialize the matrix
-  using AlgorithmTrait = AlignmentAlgorithmTrait<algorithm_tag>;
+  using AlgorithmTrait = AlignmentAlgorithmTrait<algorithm_tag, Score, Layout>;
   using Matrix = typename AlgorithmTrait::MatrixTy;
 
   Matrix M(s1.length() + 1, s2.length() + 1);
   AlgorithmTrait::InitializeMatrix(S, M);
+  ScoreProfile P(s2, S);
 
   // Fill in the matrix top to bottom, left to right
+  std::tuple<size_t, size_t, ssize_t> best(0, 0, 0);
   for (size_t i = 1; i < M.rows(); ++i) {
+    const auto scores = P.Row(s1[i-1]);
     for (size_t j = 1; j < M.columns(); ++j) {
-      AlgorithmTrait::ComputeScore(S, M, i, j, s1[i-1], s2[j-1]);
+      AlgorithmTrait::ComputeScore(S, M, i, j, scores[j-1]);
+      AlgorithmTrait::UpdateBestScore(M, i, j, best);
     }
   }
 
@@ -434,47 +902,81 @@ Alignment(const Sequence &s1, const Sequence &s2,
   ssize_t score;
   Action action;
   std::tie(startI, startJ, score, action) =
-      AlgorithmTrait::GetFinalScoreAndAction(M, s1, s2);
+      AlgorithmTrait::GetFinalScoreAndAction(M, s1, s2, best);
 
-  std::deque<Action> actionStack;
+  Cigar actionStack;
 
   std::tie(actionStack, endI, endJ) =
       TraceBackActions<algorithm_tag>(
           M, startI, startJ, action, score, S, s1, s2);
 
-  if (startI != M.rows() - 1 || startJ != M.columns() - 1) {
-    size_t diagonal = std::min(s1.length() - startI, s2.length() - startJ);
-    actionStack.insert(
-        std::begin(actionStack),
-        diagonal,
-        Action::DC_MatchMismatch);
-    if (s1.length() - startI > s2.length() - startJ) {
-      actionStack.insert(
-          std::begin(actionStack),
-          (s1.length() - startI) - (s2.length() - startJ), Action::DC_Deletion);
-    } else if (s1.length() < s2.length()) {
-      actionStack.insert(
-          std::begin(actionStack),
-          (s2.length() - startJ) - (s1.length() - startI), Action::DC_Insertion);
-    }
-  }
+  actionStack.SetCoordinates(s1.length(), s2.length(),
+                             endI, endJ, startI, startJ);
+
+  return actionStack;
+}
+
+//! \brief The size in bytes of a cell of the table aligning s1 and s2.
+inline size_t
+AlignmentCellSize(const Sequence &s1, const Sequence &s2, const ScoreTable &S) {
+  return DispatchScoreType(
+      s1.length() + 1, s2.length() + 1, S,
+      [](auto score) { return sizeof(BasicAffineCell<decltype(score)>); });
+}
+
+//! \brief The alignment procedure.
+//!
+//! The table stores its scores in three planes of the narrowest integer type
+//! holding every score of the alignment of s1 and s2.
+//!
+//! \param s1 The first sequence
+//! \param s2 The second sequence
+//! \param S  The score table
+//! \returns The alignment of s1 and s2
+template <typename algorithm_tag>
+Cigar
+Alignment(const Sequence &s1, const Sequence &s2,
+          ScoreTable &S, const algorithm_tag &) {
+  return DispatchScoreType(
+      s1.length() + 1, s2.length() + 1, S,
+      [&](auto score) {
+        return BasicAlignment<algorithm_tag, decltype(score),
+                              struct_of_arrays_tag>(s1, s2, S);
+      });
+}
 
-  if (endI != 0 || endJ != 0) {
-    actionStack.insert(
-        std::end(actionStack),
-        std::min(endI, endJ), Action::DC_MatchMismatch);
-    if (endI > endJ) {
-      actionStack.insert(
-          std::end(actionStack),
-          endI - endJ, Action::DC_Deletion);
-    } else if (endJ > endI) {
-      actionStack.insert(
-          std::end(actionStack),
-          endJ - endI, Action::DC_Insertion);
+//! \brief The score only alignment procedure.
+//!
+//! Compute the optimal score keeping only two rows of the dynamic programming
+//! table and without running the traceback.
+//!
+//! \param s1 The first sequence
+//! \param s2 The second sequence
+//! \param S  The score table
+//! \returns The cell (i,j) where the optimal alignment ends and its score.
+template <typename algorithm_tag>
+std::tuple<size_t, size_t, ssize_t>
+AlignmentScore(const Sequence &s1, const Sequence &s2,
+               const ScoreTable &S, const algorithm_tag &) {
+  using AlgorithmTrait = AlignmentAlgorithmTrait<algorithm_tag>;
+  using Matrix = RollingMatrix<typename AlgorithmTrait::CellTy>;
+
+  Matrix M(s1.length() + 1, s2.length() + 1);
+  AlgorithmTrait::InitializeRow(S, M, 0);
+  ScoreProfile P(s2, S);
+
+  std::tuple<size_t, size_t, ssize_t> best(0, 0, 0);
+  for (size_t i = 1; i < M.rows(); ++i) {
+    AlgorithmTrait::InitializeRow(S, M, i);
+    const auto scores = P.Row(s1[i-1]);
+    for (size_t j = 1; j < M.columns(); ++j) {
+      AlgorithmTrait::ComputeScore(S, M, i, j, scores[j-1]);
+      AlgorithmTrait::UpdateBestScore(M, i, j, best);
     }
   }
 
-  return actionStack;
+  return AlgorithmTrait::GetFinalScore(
+      M, M.rows() - 1, M.columns() - 1, best);
 }
 
 }
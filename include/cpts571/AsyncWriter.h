@@ -0,0 +1,148 @@
+//===------------------------------------------------------------*- C++ -*-===//
+//
+// Copyright 2017 Marco Minutoli <mminutoli@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License. You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+namespace cpts571 {
+
+//! \brief The work of an AsyncWriter over its lifetime.
+struct WriterStats {
+  size_t bytes = 0;
+  size_t blocks = 0;
+  //! The time the writer thread spent writing the blocks.
+  double writeTime = 0;
+  //! The time the producer waited for the previous block to be written.
+  double waitTime = 0;
+};
+
+//! \brief Write to a stream on a dedicated thread through two large blocks.
+//!
+//! The producer fills the front block while the writer thread writes the back
+//! one, and the two are swapped when the front block is full.  The producer
+//! waits only when it fills a block before the previous one is written, and
+//! the stream sees a few large writes instead of a flush per line.
+class AsyncWriter {
+ public:
+  //! \brief Constructor
+  //! \param O The stream receiving the output
+  //! \param blockSize The size in bytes of the blocks
+  explicit AsyncWriter(std::ostream & O, size_t blockSize = 1 << 22)
+      : O_(O), blockSize_(blockSize)
+      , full_(false), closed_(false) {
+    front_.reserve(blockSize_);
+    back_.reserve(blockSize_);
+    thread_ = std::thread([this]() { Run(); });
+  }
+
+  AsyncWriter(const AsyncWriter &) = delete;
+  AsyncWriter & operator=(const AsyncWriter &) = delete;
+
+  ~AsyncWriter() { Close(); }
+
+  //! \brief Append s to the output.
+  void Write(const std::string & s) {
+    front_.append(s);
+    if (front_.size() >= blockSize_) Flush();
+  }
+
+  //! \brief Write what is left and wait for the writer thread.
+  void Close() {
+    if (!thread_.joinable()) return;
+
+    Flush();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    O_.flush();
+  }
+
+  //! \brief The statistics, complete once the writer is closed.
+  const WriterStats & Stats() const { return stats_; }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  static double Seconds(Clock::time_point begin, Clock::time_point end) {
+    return std::chrono::duration_cast<
+      std::chrono::duration<double> >(end - begin).count();
+  }
+
+  //! \brief Hand the front block to the writer thread.
+  void Flush() {
+    if (front_.empty()) return;
+
+    auto beginWait = Clock::now();
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return !full_; });
+    stats_.waitTime += Seconds(beginWait, Clock::now());
+
+    front_.swap(back_);
+    full_ = true;
+    lock.unlock();
+    cv_.notify_all();
+  }
+
+  void Run() {
+    for (;;) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return full_ || closed_; });
+      if (!full_) break;
+      lock.unlock();
+
+      // The producer does not touch the back block until it is released.
+      auto beginWrite = Clock::now();
+      O_.write(back_.data(), back_.size());
+      stats_.writeTime += Seconds(beginWrite, Clock::now());
+      stats_.bytes += back_.size();
+      ++stats_.blocks;
+      back_.clear();
+
+      lock.lock();
+      full_ = false;
+      lock.unlock();
+      cv_.notify_all();
+    }
+  }
+
+  std::ostream & O_;
+  const size_t blockSize_;
+  std::string front_;
+  std::string back_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool full_;
+  bool closed_;
+  WriterStats stats_;
+  std::thread thread_;
+};
+
+}  // namespace cpts571
+
+#endif  // ASYNC_WRITER_H
@@ -0,0 +1,212 @@
+//===------------------------------------------------------------*- C++ -*-===//
+//
+// Copyright 2017 Marco Minutoli <mminutoli@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License. You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef BANDED_ALIGNMENT_H
+#define BANDED_ALIGNMENT_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+
+#include "cpts571/Alignment.h"
+#include "cpts571/Sequence.h"
+
+namespace cpts571 {
+
+//! \brief Dynamic programming table storing only a band around a diagonal.
+//!
+//! The cell (i,j) is in the band when |(i - j) - diagonal| <= width.  Every
+//! row stores the 2 * width + 1 cells of the band plus one guard cell on each
+//! side, so that the neighbors of a cell in the band are always stored.
+//! \tparam Cell The type of the cell in the table.
+template <typename Cell>
+class BandedMatrix {
+ public:
+  using CellTy = Cell;
+
+  //! \brief Constructor
+  //! \param rows Number of rows
+  //! \param columns Number of columns
+  //! \param diagonal The diagonal i - j at the center of the band
+  //! \param width The number of diagonals on each side of the center
+  BandedMatrix(size_t rows, size_t columns, ssize_t diagonal, size_t width)
+      : rows_(rows), columns_(columns)
+      , diagonal_(diagonal), width_(width)
+      , stride_(2 * width + 3)
+      , matrix_(new CellTy[rows * stride_]) {}
+
+  //! \brief Return the number of rows of the matrix
+  size_t rows() const { return rows_; }
+
+  //! \brief Return the number of columns of the matrix
+  size_t columns() const { return columns_; }
+
+  //! \brief Return the diagonal at the center of the band
+  ssize_t diagonal() const { return diagonal_; }
+
+  //! \brief Return the width of the band
+  size_t width() const { return width_; }
+
+  //! \brief First column of the row i stored in the table (guard included)
+  ssize_t FirstColumn(size_t i) const {
+    return ssize_t(i) - diagonal_ - ssize_t(width_) - 1;
+  }
+
+  //! \brief Last column of the row i stored in the table (guard included)
+  ssize_t LastColumn(size_t i) const {
+    return ssize_t(i) - diagonal_ + ssize_t(width_) + 1;
+  }
+
+  //! \brief Check if the cell (i,j) is on the edge of the band
+  bool OnEdge(size_t i, size_t j) const {
+    ssize_t d = ssize_t(i) - ssize_t(j) - diagonal_;
+    return d == ssize_t(width_) || d == -ssize_t(width_);
+  }
+
+  //! \brief Get the cell (i,j) of the matrix
+  CellTy & operator()(size_t row, size_t column) const {
+    return matrix_[row * stride_ + (ssize_t(column) - FirstColumn(row))];
+  }
+
+ private:
+  size_t rows_;
+  size_t columns_;
+  ssize_t diagonal_;
+  size_t width_;
+  size_t stride_;
+  std::unique_ptr<CellTy[]> matrix_;
+};
+
+//! \brief Fill and trace back the band of the table.
+//!
+//! \returns The alignment and a flag telling if its path touches the edge of
+//! the band.
+template <typename algorithm_tag>
+std::tuple<Cigar, bool>
+BandedAlignmentStep(const Sequence &s1, const Sequence &s2,
+                    const ScoreTable &S, ssize_t diagonal, size_t width) {
+  using AlgorithmTrait = AlignmentAlgorithmTrait<algorithm_tag>;
+  using Matrix = BandedMatrix<typename AlgorithmTrait::CellTy>;
+
+  Matrix M(s1.length() + 1, s2.length() + 1, diagonal, width);
+
+  const auto inf = ScoreTraits<ssize_t>::NegativeInfinity();
+  typename AlgorithmTrait::CellTy outside{ inf, inf, inf };
+
+  // Cells out of the table and guard cells never contribute to the score.
+  for (size_t i = 0; i < M.rows(); ++i) {
+    for (ssize_t j = M.FirstColumn(i); j <= M.LastColumn(i); ++j) {
+      if (j < 0 || j >= ssize_t(M.columns()))
+        M(i, j) = outside;
+      else if (i == 0 || j == 0)
+        M(i, j) = AlgorithmTrait::BoundaryCell(S, i, j);
+      else
+        M(i, j) = outside;
+    }
+  }
+
+  // Fill in the band top to bottom, left to right
+  ScoreProfile P(s2, S);
+  std::tuple<size_t, size_t, ssize_t> best(0, 0, 0);
+  for (size_t i = 1; i < M.rows(); ++i) {
+    ssize_t firstJ = std::max<ssize_t>(1, M.FirstColumn(i) + 1);
+    ssize_t lastJ = std::min<ssize_t>(M.columns() - 1, M.LastColumn(i) - 1);
+    const auto scores = P.Row(s1[i-1]);
+    for (ssize_t j = firstJ; j <= lastJ; ++j) {
+      AlgorithmTrait::ComputeScore(S, M, i, j, scores[j-1]);
+      AlgorithmTrait::UpdateBestScore(M, i, j, best);
+    }
+  }
+
+  size_t startI, startJ, endI, endJ;
+  ssize_t score;
+  Action action;
+  std::tie(startI, startJ, score, action) =
+      AlgorithmTrait::GetFinalScoreAndAction(M, s1, s2, best);
+
+  Cigar actionStack;
+  std::tie(actionStack, endI, endJ) =
+      TraceBackActions<algorithm_tag>(
+          M, startI, startJ, action, score, S, s1, s2);
+
+  // Walk the path from its last cell to check if it touches the band edge.
+  bool onEdge = M.OnEdge(startI, startJ);
+  size_t i = startI, j = startJ;
+  for (auto & run : actionStack.runs()) {
+    for (size_t k = 0; k < run.length && !onEdge; ++k) {
+      if (run.action != Action::Insertion) --i;
+      if (run.action != Action::Deletion) --j;
+      onEdge = M.OnEdge(i, j);
+    }
+  }
+
+  actionStack.SetCoordinates(s1.length(), s2.length(),
+                             endI, endJ, startI, startJ);
+
+  return std::make_tuple(actionStack, onEdge);
+}
+
+//! \brief The banded alignment procedure.
+//!
+//! Compute only the cells of the table within width diagonals from the given
+//! diagonal.  When the path of the alignment touches the edge of the band, a
+//! better alignment might lie outside of it: the band is doubled and the
+//! alignment computed again until the band covers the whole table.
+//!
+//! \param s1 The first sequence
+//! \param s2 The second sequence
+//! \param S  The score table
+//! \param diagonal The expected diagonal i - j of the alignment
+//! \param width The initial number of diagonals on each side of diagonal
+//! \returns The alignment of s1 and s2
+template <typename algorithm_tag>
+Cigar
+BandedAlignment(const Sequence &s1, const Sequence &s2,
+                const ScoreTable &S, const algorithm_tag &,
+                ssize_t diagonal, size_t width) {
+  // The band covering the whole table.
+  size_t maxWidth = std::max<ssize_t>(
+      ssize_t(s1.length()) - diagonal, diagonal + ssize_t(s2.length()));
+
+  // The first and the last cell of a global alignment must be in the band.
+  if (std::is_same<algorithm_tag, global_alignment_tag>::value) {
+    ssize_t d = ssize_t(s1.length()) - ssize_t(s2.length()) - diagonal;
+    width = std::max<size_t>(width, std::max(std::abs(d), std::abs(diagonal)));
+  }
+  width = std::max<size_t>(1, std::min(width, maxWidth));
+
+  Cigar actions;
+  bool onEdge;
+  std::tie(actions, onEdge) =
+      BandedAlignmentStep<algorithm_tag>(s1, s2, S, diagonal, width);
+  while (onEdge && width < maxWidth) {
+    width = std::min(2 * width, maxWidth);
+    std::tie(actions, onEdge) =
+        BandedAlignmentStep<algorithm_tag>(s1, s2, S, diagonal, width);
+  }
+
+  return actions;
+}
+
+}  // namespace cpts571
+
+#endif  // BANDED_ALIGNMENT_H
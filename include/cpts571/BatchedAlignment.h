@@ -0,0 +1,315 @@
+//===------------------------------------------------------------*- C++ -*-===//
+//
+// Copyright 2017 Marco Minutoli <mminutoli@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License. You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef BATCHED_ALIGNMENT_H
+#define BATCHED_ALIGNMENT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "cpts571/Alignment.h"
+#include "cpts571/CompactAlignment.h"
+#include "cpts571/Sequence.h"
+#include "cpts571/StripedAlignment.h"
+
+namespace cpts571 {
+
+//! \brief The traceback directions of one lane of a batch.
+//!
+//! The directions of the cell (i,j) of all the lanes are stored next to each
+//! other, so that the kernel writes them with a single store.
+class BatchedDirections {
+ public:
+  //! \brief Constructor
+  //! \param bits The directions of the batch
+  //! \param columns The number of columns of the batch table
+  //! \param lanes The number of lanes of the batch
+  //! \param lane The lane seen through this table
+  BatchedDirections(const uint8_t *bits, size_t columns, size_t lanes,
+                    size_t lane)
+      : bits_(bits), columns_(columns), lanes_(lanes), lane_(lane) {}
+
+  //! \brief Get the cell (i,j) of the matrix
+  uint8_t operator()(size_t row, size_t column) const {
+    return bits_[(row * columns_ + column) * lanes_ + lane_];
+  }
+
+  //! \brief The score of the predecessor of the score state of (i,j).
+  DirectionMatrix::State
+  From(size_t i, size_t j, DirectionMatrix::State state) const {
+    return DirectionMatrix::From((*this)(i, j), state);
+  }
+
+  //! \brief Check if the match score of the cell (i,j) is zero.
+  bool MatchIsZero(size_t i, size_t j) const {
+    return ((*this)(i, j) & DirectionMatrix::ZeroMatch) != 0;
+  }
+
+ private:
+  const uint8_t *bits_;
+  size_t columns_;
+  size_t lanes_;
+  size_t lane_;
+};
+
+#if defined(CPTS571_STRIPED_ALIGNMENT)
+
+//! \brief The local alignments of up to Ops::Lanes pairs, one per lane.
+//!
+//! The tables of the pairs are filled in lockstep over the rows and the
+//! columns of the largest one, with the recurrences of the local alignment
+//! trait.  Each cell depends only on cells above and to its left, so the
+//! cells past the end of a shorter pair never reach its own cells and are
+//! only kept out of its best score.  Before each row the scores of its cells
+//! are copied from the ScoreProfile of each pair, one load per cell, or
+//! without a substitution matrix compared on all the lanes at once.
+//!
+//! \param s1 The first sequences of the pairs
+//! \param s2 The second sequences of the pairs
+//! \param pairs The number of pairs, at most Ops::Lanes
+//! \param S The score table
+//! \param out The alignment of each pair
+template <typename Ops>
+void
+BatchedAlignment(const Sequence * const *s1, const Sequence * const *s2,
+                 size_t pairs, const ScoreTable &S, Cigar *out) {
+  using Vec = typename Ops::Vec;
+  using Elem = typename Ops::Elem;
+  const size_t L = Ops::Lanes;
+
+  size_t rows = 0, columns = 0;
+  std::vector<Elem> lastRow(L, 0), lastColumn(L, 0);
+  for (size_t k = 0; k < pairs; ++k) {
+    lastRow[k] = s1[k]->length();
+    lastColumn[k] = s2[k]->length();
+    rows = std::max(rows, s1[k]->length() + 1);
+    columns = std::max(columns, s2[k]->length() + 1);
+  }
+
+  // The characters of the pairs, transposed to one vector per position.
+  std::vector<Elem> chars1((rows - 1) * L, 0), chars2((columns - 1) * L, 0);
+  for (size_t k = 0; k < pairs; ++k) {
+    for (size_t i = 0; i < s1[k]->length(); ++i)
+      chars1[i * L + k] = uint8_t((*s1[k])[i]);
+    for (size_t j = 0; j < s2[k]->length(); ++j)
+      chars2[j * L + k] = uint8_t((*s2[k])[j]);
+  }
+
+  // The scores of the row of each pair, transposed to one vector per column.
+  std::vector<ScoreProfile> profiles;
+  if (S.Substitution)
+    for (size_t k = 0; k < pairs; ++k) profiles.emplace_back(*s2[k], S);
+  std::vector<Elem> scores((columns - 1) * L, 0);
+
+  const Elem inf = ScoreTraits<Elem>::NegativeInfinity();
+  const Vec vInf = Ops::Set1(inf);
+  const Vec vZero = Ops::Zero();
+  const Vec vMatch = Ops::Set1(S.Match);
+  const Vec vMismatch = Ops::Set1(S.Mismatch);
+  const Vec vOpen = Ops::Set1(S.H + S.G);
+  const Vec vExtend = Ops::Set1(S.G);
+  const Vec vLastRow = Ops::Load(lastRow.data());
+  const Vec vLastColumn = Ops::Load(lastColumn.data());
+
+  // The index of the largest score in priority Match, Insertion, Deletion,
+  // shifted to the bits of the given state.
+  auto argmax = [&](Vec m, Vec ins, Vec del, size_t state) {
+    const Vec one = Ops::Set1(DirectionMatrix::FromInsertion << (2 * state));
+    const Vec two = Ops::Set1(DirectionMatrix::FromDeletion << (2 * state));
+    Vec notMatch = Ops::Or(Ops::Greater(ins, m), Ops::Greater(del, m));
+    return Ops::Select(
+        notMatch, Ops::Select(Ops::Greater(del, ins), two, one), vZero);
+  };
+
+  // One row of scores, updated in place.
+  std::vector<Elem> M(columns * L), I(columns * L), D(columns * L);
+  for (size_t j = 0; j < columns; ++j) {
+    Ops::Store(&M[j * L], j == 0 ? vZero : vInf);
+    Ops::Store(&I[j * L], j == 0 ? vInf : vZero);
+    Ops::Store(&D[j * L], vInf);
+  }
+
+  // Only the cells of the rows and columns past the first are written.
+  std::unique_ptr<uint8_t[]> directions(new uint8_t[rows * columns * L]);
+
+  Vec best = vZero, bestI = vZero, bestJ = vZero;
+  for (size_t i = 1; i < rows; ++i) {
+    if (S.Substitution) {
+      for (size_t k = 0; k < pairs; ++k) {
+        if (i > s1[k]->length()) continue;
+        const auto row = profiles[k].Row((*s1[k])[i - 1]);
+        for (size_t j = 0; j < s2[k]->length(); ++j)
+          scores[j * L + k] = row[j];
+      }
+    } else {
+      const Vec a = Ops::Load(&chars1[(i - 1) * L]);
+      for (size_t j = 0; j + 1 < columns; ++j)
+        Ops::Store(&scores[j * L], Ops::Select(
+            Ops::Equal(a, Ops::Load(&chars2[j * L])), vMatch, vMismatch));
+    }
+
+    const Vec vI = Ops::Set1(i);
+    const Vec rowOut = Ops::Greater(vI, vLastRow);
+
+    Vec diagonalM = Ops::Load(&M[0]);
+    Vec diagonalI = Ops::Load(&I[0]);
+    Vec diagonalD = Ops::Load(&D[0]);
+    Vec leftM = vInf, leftI = vInf, leftD = vZero;
+    Ops::Store(&M[0], leftM);
+    Ops::Store(&I[0], leftI);
+    Ops::Store(&D[0], leftD);
+
+    for (size_t j = 1; j < columns; ++j) {
+      const Vec upM = Ops::Load(&M[j * L]);
+      const Vec upI = Ops::Load(&I[j * L]);
+      const Vec upD = Ops::Load(&D[j * L]);
+
+      const Vec s = Ops::Load(&scores[(j - 1) * L]);
+
+      Vec m = Ops::Max(Ops::Max(diagonalM, diagonalI), diagonalD);
+      m = Ops::Max(Ops::Adds(m, s), vZero);
+
+      const Vec leftOpenM = Ops::Adds(leftM, vOpen);
+      const Vec leftExtendI = Ops::Adds(leftI, vExtend);
+      const Vec leftOpenD = Ops::Adds(leftD, vOpen);
+      const Vec ins = Ops::Max(Ops::Max(leftOpenM, leftExtendI), leftOpenD);
+
+      const Vec upOpenM = Ops::Adds(upM, vOpen);
+      const Vec upOpenI = Ops::Adds(upI, vOpen);
+      const Vec upExtendD = Ops::Adds(upD, vExtend);
+      const Vec del = Ops::Max(Ops::Max(upOpenM, upOpenI), upExtendD);
+
+      Vec bits = Ops::Or(
+          Ops::Or(argmax(diagonalM, diagonalI, diagonalD,
+                         DirectionMatrix::FromMatch),
+                  argmax(leftOpenM, leftExtendI, leftOpenD,
+                         DirectionMatrix::FromInsertion)),
+          argmax(upOpenM, upOpenI, upExtendD, DirectionMatrix::FromDeletion));
+      bits = Ops::Or(bits, Ops::Select(
+          Ops::Equal(m, vZero), Ops::Set1(DirectionMatrix::ZeroMatch), vZero));
+      Ops::StoreBytes(&directions[(i * columns + j) * L], bits);
+
+      const Vec vJ = Ops::Set1(j);
+      const Vec outside = Ops::Or(rowOut, Ops::Greater(vJ, vLastColumn));
+      const Vec better = Ops::Select(outside, vZero, Ops::Greater(m, best));
+      best = Ops::Select(better, m, best);
+      bestI = Ops::Select(better, vI, bestI);
+      bestJ = Ops::Select(better, vJ, bestJ);
+
+      Ops::Store(&M[j * L], m);
+      Ops::Store(&I[j * L], ins);
+      Ops::Store(&D[j * L], del);
+
+      diagonalM = upM;
+      diagonalI = upI;
+      diagonalD = upD;
+      leftM = m;
+      leftI = ins;
+      leftD = del;
+    }
+  }
+
+  std::vector<Elem> bestScores(L), bestRows(L), bestColumns(L);
+  Ops::Store(bestScores.data(), best);
+  Ops::Store(bestRows.data(), bestI);
+  Ops::Store(bestColumns.data(), bestJ);
+
+  for (size_t k = 0; k < pairs; ++k) {
+    // Without a positive score the alignment is left to the scalar procedure.
+    if (bestScores[k] == 0) {
+      ScoreTable scores = S;
+      out[k] = Alignment(*s1[k], *s2[k], scores, local_alignment_tag());
+      continue;
+    }
+
+    // With a substitution matrix different characters may score positive.
+    size_t endI, endJ;
+    Action action = (*s1[k])[bestRows[k] - 1] == (*s2[k])[bestColumns[k] - 1]
+        ? Action::Match : Action::Mismatch;
+    std::tie(out[k], endI, endJ) = TraceBackDirections<local_alignment_tag>(
+        BatchedDirections(directions.get(), columns, L, k),
+        bestRows[k], bestColumns[k], action, *s1[k], *s2[k]);
+    out[k].SetCoordinates(s1[k]->length(), s2[k]->length(),
+                          endI, endJ, bestRows[k], bestColumns[k]);
+  }
+}
+
+#endif
+
+//! \brief The local alignments of many independent pairs.
+//!
+//! The pairs are aligned in groups filling the 16-bit lanes of the vector
+//! unit, one pair per lane.  Pairs whose scores may not fit 16 bits, and all
+//! the pairs when the vector unit is not available, are aligned one by one.
+//! The actions are the same of Alignment(s1, s2, S, local_alignment_tag()).
+//!
+//! \param s1 The first sequences of the pairs
+//! \param s2 The second sequences of the pairs
+//! \param S  The score table
+//! \returns The alignments of the pairs
+inline std::vector<Cigar>
+BatchedAlignment(const std::vector<const Sequence *> &s1,
+                 const std::vector<const Sequence *> &s2,
+                 const ScoreTable &S) {
+  std::vector<Cigar> result(s1.size());
+  ScoreTable scores = S;
+
+#if defined(CPTS571_STRIPED_ALIGNMENT)
+  using Ops = StripedI16Ops;
+  std::vector<const Sequence *> batch1, batch2;
+  std::vector<size_t> slots;
+
+  auto flush = [&]() {
+    std::vector<Cigar> actions(batch1.size());
+    BatchedAlignment<Ops>(batch1.data(), batch2.data(), batch1.size(), S,
+                          actions.data());
+    for (size_t k = 0; k < slots.size(); ++k)
+      result[slots[k]] = std::move(actions[k]);
+    batch1.clear();
+    batch2.clear();
+    slots.clear();
+  };
+
+  for (size_t p = 0; p < s1.size(); ++p) {
+    if (!ScoreTraits<int16_t>::Fits(
+            s1[p]->length() + 1, s2[p]->length() + 1, S)) {
+      result[p] = Alignment(*s1[p], *s2[p], scores, local_alignment_tag());
+      continue;
+    }
+
+    batch1.push_back(s1[p]);
+    batch2.push_back(s2[p]);
+    slots.push_back(p);
+    if (slots.size() == Ops::Lanes) flush();
+  }
+  if (!slots.empty()) flush();
+#else
+  for (size_t p = 0; p < s1.size(); ++p)
+    result[p] = Alignment(*s1[p], *s2[p], scores, local_alignment_tag());
+#endif
+
+  return result;
+}
+
+}  // namespace cpts571
+
+#endif  // BATCHED_ALIGNMENT_H
@@ -0,0 +1,208 @@
+//===------------------------------------------------------------*- C++ -*-===//
+//
+// Copyright 2017 Marco Minutoli <mminutoli@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License. You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+namespace cpts571 {
+
+//! \brief The occupancy of a BoundedQueue over its lifetime.
+struct QueueStats {
+  size_t capacity = 0;
+  size_t pushes = 0;
+  double meanOccupancy = 0;
+  size_t maxOccupancy = 0;
+  //! The pushes that found the queue full.
+  size_t fullWaits = 0;
+  //! The pops that found the queue empty.
+  size_t emptyWaits = 0;
+};
+
+//! \brief A lock-free queue of at most a fixed number of elements between
+//! threads.
+//!
+//! The multiple producer, multiple consumer ring buffer of Vyukov.  Every
+//! slot carries a sequence number telling whether it is free for the push of
+//! a given position or full for the pop of that position, so producers and
+//! consumers only compete on their own position counter.  Push waits while
+//! the queue is full and Pop while it is empty, so a fast producer cannot
+//! hold more than capacity elements in memory.
+template <typename T>
+class BoundedQueue {
+ public:
+  //! \brief Constructor
+  //! \param capacity The maximum number of elements, rounded up to a power of
+  //! two
+  explicit BoundedQueue(size_t capacity)
+      : capacity_(RoundUp(capacity)), mask_(capacity_ - 1)
+      , slots_(new Slot[capacity_])
+      , pushPosition_(0), popPosition_(0), closed_(false)
+      , pushes_(0), occupancySum_(0), maxOccupancy_(0)
+      , fullWaits_(0), emptyWaits_(0) {
+    for (size_t i = 0; i < capacity_; ++i)
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue & operator=(const BoundedQueue &) = delete;
+
+  //! \brief Append e if the queue is not full.
+  bool TryPush(T & e) {
+    size_t position = pushPosition_.load(std::memory_order_relaxed);
+    Slot * slot;
+    for (;;) {
+      slot = &slots_[position & mask_];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      ssize_t difference = ssize_t(sequence) - ssize_t(position);
+      if (difference == 0 &&
+          pushPosition_.compare_exchange_weak(
+              position, position + 1, std::memory_order_relaxed))
+        break;
+      else if (difference < 0)
+        return false;
+      else if (difference > 0)
+        position = pushPosition_.load(std::memory_order_relaxed);
+    }
+
+    slot->value = std::move(e);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  //! \brief Take the first element if the queue is not empty.
+  bool TryPop(T & e) {
+    size_t position = popPosition_.load(std::memory_order_relaxed);
+    Slot * slot;
+    for (;;) {
+      slot = &slots_[position & mask_];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      ssize_t difference = ssize_t(sequence) - ssize_t(position + 1);
+      if (difference == 0 &&
+          popPosition_.compare_exchange_weak(
+              position, position + 1, std::memory_order_relaxed))
+        break;
+      else if (difference < 0)
+        return false;
+      else if (difference > 0)
+        position = popPosition_.load(std::memory_order_relaxed);
+    }
+
+    e = std::move(slot->value);
+    slot->sequence.store(position + capacity_, std::memory_order_release);
+    return true;
+  }
+
+  //! \brief Append e, waiting for a free slot.
+  void Push(T e) {
+    if (!TryPush(e)) {
+      fullWaits_.fetch_add(1, std::memory_order_relaxed);
+      for (size_t attempt = 0; !TryPush(e); ++attempt) Backoff(attempt);
+    }
+
+    size_t occupancy = size();
+    pushes_.fetch_add(1, std::memory_order_relaxed);
+    occupancySum_.fetch_add(occupancy, std::memory_order_relaxed);
+    size_t max = maxOccupancy_.load(std::memory_order_relaxed);
+    while (max < occupancy &&
+           !maxOccupancy_.compare_exchange_weak(
+               max, occupancy, std::memory_order_relaxed)) {}
+  }
+
+  //! \brief Take the first element, waiting for one.
+  //! \returns false once the queue is closed and empty.
+  bool Pop(T & e) {
+    if (TryPop(e)) return true;
+
+    emptyWaits_.fetch_add(1, std::memory_order_relaxed);
+    for (size_t attempt = 0;; ++attempt) {
+      if (TryPop(e)) return true;
+      // The pushes happen before Close: once it is seen, an empty queue stays
+      // empty.
+      if (closed_.load(std::memory_order_acquire)) return TryPop(e);
+      Backoff(attempt);
+    }
+  }
+
+  //! \brief Signal that no more elements will be pushed.
+  void Close() { closed_.store(true, std::memory_order_release); }
+
+  //! \brief The number of elements in the queue, as seen by the caller.
+  size_t size() const {
+    size_t push = pushPosition_.load(std::memory_order_relaxed);
+    size_t pop = popPosition_.load(std::memory_order_relaxed);
+    return push > pop ? std::min(push - pop, capacity_) : 0;
+  }
+
+  size_t capacity() const { return capacity_; }
+
+  QueueStats Stats() const {
+    QueueStats stats;
+    stats.capacity = capacity_;
+    stats.pushes = pushes_.load();
+    stats.meanOccupancy =
+        stats.pushes ? double(occupancySum_.load()) / stats.pushes : 0;
+    stats.maxOccupancy = maxOccupancy_.load();
+    stats.fullWaits = fullWaits_.load();
+    stats.emptyWaits = emptyWaits_.load();
+    return stats;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  static size_t RoundUp(size_t capacity) {
+    size_t result = 1;
+    while (result < capacity) result <<= 1;
+    return result;
+  }
+
+  //! Spin for a short while, then give the core to the other stages.
+  static void Backoff(size_t attempt) {
+    if (attempt < 16)
+      std::this_thread::yield();
+    else
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  // Producers and consumers update their positions on different cache lines.
+  alignas(64) std::atomic<size_t> pushPosition_;
+  alignas(64) std::atomic<size_t> popPosition_;
+  alignas(64) std::atomic<bool> closed_;
+  std::atomic<size_t> pushes_;
+  std::atomic<size_t> occupancySum_;
+  std::atomic<size_t> maxOccupancy_;
+  std::atomic<size_t> fullWaits_;
+  std::atomic<size_t> emptyWaits_;
+};
+
+}  // namespace cpts571
+
+#endif  // BOUNDED_QUEUE_H
@@ -0,0 +1,211 @@
+//===------------------------------------------------------------*- C++ -*-===//
+//
+// Copyright 2017 Marco Minutoli <mminutoli@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License. You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef CIGAR_H
+#define CIGAR_H
+
+#include <algorithm>
+#include <deque>
+#include <ostream>
+#include <vector>
+
+namespace cpts571 {
+
+//! \brief Possible actions during alignment
+enum class Action {
+  Match,
+  Mismatch,
+  Insertion,
+  Deletion,
+  DC_MatchMismatch, //< This is a don't care action needed for the print routine
+  DC_Insertion,     //< This is a don't care action needed for the print routine
+  DC_Deletion       //< This is a don't care action needed for the print routine
+};
+
+//! \brief Pad the list of actions with the don't care actions needed by the
+//! print routine to cover the parts of two sequences of length length1 and
+//! length2 outside the alignment.
+//!
+//! \param actionStack The actions from the cell (startI, startJ) back to the
+//! cell (endI, endJ)
+inline void
+AddDontCareActions(std::deque<Action> & actionStack,
+                   size_t length1, size_t length2,
+                   size_t startI, size_t startJ, size_t endI, size_t endJ) {
+  if (startI != length1 || startJ != length2) {
+    size_t diagonal = std::min(length1 - startI, length2 - startJ);
+    actionStack.insert(
+        std::begin(actionStack),
+        diagonal,
+        Action::DC_MatchMismatch);
+    if (length1 - startI > length2 - startJ) {
+      actionStack.insert(
+          std::begin(actionStack),
+          (length1 - startI) - (length2 - startJ), Action::DC_Deletion);
+    } else if (length2 - startJ > length1 - startI) {
+      actionStack.insert(
+          std::begin(actionStack),
+          (length2 - startJ) - (length1 - startI), Action::DC_Insertion);
+    }
+  }
+
+  if (endI != 0 || endJ != 0) {
+    actionStack.insert(
+        std::end(actionStack),
+        std::min(endI, endJ), Action::DC_MatchMismatch);
+    if (endI > endJ) {
+      actionStack.insert(
+          std::end(actionStack),
+          endI - endJ, Action::DC_Deletion);
+    } else if (endJ > endI) {
+      actionStack.insert(
+          std::end(actionStack),
+          endJ - endI, Action::DC_Insertion);
+    }
+  }
+}
+
+//! \brief Run-length encoded alignment of two sequences.
+//!
+//! The alignment is stored as runs of equal actions, in the same order of the
+//! list of actions (from the end to the beginning of the alignment), together
+//! with the part of the two sequences it covers and the number of matches,
+//! mismatches and gaps.  The parts of the sequences outside the alignment are
+//! described by the coordinates instead of don't care actions.
+class Cigar {
+ public:
+  //! \brief A run of length equal actions.
+  struct Run {
+    Action action;
+    size_t length;
+  };
+
+  Cigar()
+      : runs_()
+      , matches_(0), mismatches_(0), insertions_(0), deletions_(0)
+      , openingGaps_(0)
+      , length1_(0), length2_(0)
+      , begin1_(0), begin2_(0), end1_(0), end2_(0) {}
+
+  //! \brief Add count actions in front of the beginning of the alignment.
+  //!
+  //! Used as the sink of the traceback, that visits the alignment from its
+  //! end to its beginning.
+  void push_back(Action action, size_t count = 1) {
+    if (count == 0) return;
+
+    if (!runs_.empty() && runs_.back().action == action) {
+      runs_.back().length += count;
+    } else {
+      runs_.push_back(Run{action, count});
+      if (action == Action::Insertion || action == Action::Deletion)
+        ++openingGaps_;
+    }
+
+    switch (action) {
+      case Action::Match: matches_ += count; break;
+      case Action::Mismatch: mismatches_ += count; break;
+      case Action::Insertion: insertions_ += count; break;
+      case Action::Deletion: deletions_ += count; break;
+      default: break;
+    }
+  }
+
+  //! \brief Set the part of the sequences covered by the alignment.
+  //!
+  //! \param length1 The length of the first sequence
+  //! \param length2 The length of the second sequence
+  //! \param begin1 The first position of the alignment in the first sequence
+  //! \param begin2 The first position of the alignment in the second sequence
+  //! \param end1 One past the last position in the first sequence
+  //! \param end2 One past the last position in the second sequence
+  void SetCoordinates(size_t length1, size_t length2,
+                      size_t begin1, size_t begin2, size_t end1, size_t end2) {
+    length1_ = length1;
+    length2_ = length2;
+    begin1_ = begin1;
+    begin2_ = begin2;
+    end1_ = end1;
+    end2_ = end2;
+  }
+
+  //! \brief The runs from the end to the beginning of the alignment.
+  const std::vector<Run> & runs() const { return runs_; }
+
+  size_t matches() const { return matches_; }
+  size_t mismatches() const { return mismatches_; }
+  size_t insertions() const { return insertions_; }
+  size_t deletions() const { return deletions_; }
+  size_t gaps() const { return insertions_ + deletions_; }
+  size_t openingGaps() const { return openingGaps_; }
+
+  //! \brief The number of columns of the alignment.
+  size_t length() const { return matches_ + mismatches_ + gaps(); }
+
+  size_t begin1() const { return begin1_; }
+  size_t begin2() const { return begin2_; }
+  size_t end1() const { return end1_; }
+  size_t end2() const { return end2_; }
+
+  //! \brief The list of actions, padded with the don't care actions, used by
+  //! the print routines.
+  std::deque<Action> Actions() const {
+    std::deque<Action> actionStack;
+    for (auto & run : runs_)
+      actionStack.insert(actionStack.end(), run.length, run.action);
+    AddDontCareActions(actionStack, length1_, length2_,
+                       end1_, end2_, begin1_, begin2_);
+    return actionStack;
+  }
+
+  //! \brief Print the runs from the beginning of the alignment, as in the
+  //! CIGAR strings of the SAM format (=, X, I, D).
+  friend std::ostream & operator<<(std::ostream & O, const Cigar & C) {
+    for (auto itr = C.runs_.rbegin(), end = C.runs_.rend();
+         itr != end; ++itr) {
+      O << itr->length;
+      switch (itr->action) {
+        case Action::Match: O << '='; break;
+        case Action::Mismatch: O << 'X'; break;
+        case Action::Insertion: O << 'I'; break;
+        case Action::Deletion: O << 'D'; break;
+        default: break;
+      }
+    }
+    return O;
+  }
+
+ private:
+  std::vector<Run> runs_;
+  size_t matches_;
+  size_t mismatches_;
+  size_t insertions_;
+  size_t deletions_;
+  size_t openingGaps_;
+  size_t length1_;
+  size_t length2_;
+  size_t begin1_;
+  size_t begin2_;
+  size_t end1_;
+  size_t end2_;
+};
+
+}  // namespace cpts571
+
+#endif  // CIGAR_H
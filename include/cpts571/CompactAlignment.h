@@ -0,0 +1,266 @@
+//===------------------------------------------------------------*- C++ -*-===//
+//
+// Copyright 2017 Marco Minutoli <mminutoli@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License. You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef COMPACT_ALIGNMENT_H
+#define COMPACT_ALIGNMENT_H
+
+#include <cstdint>
+#include <memory>
+#include <tuple>
+
+#include "cpts571/Alignment.h"
+#include "cpts571/Sequence.h"
+
+namespace cpts571 {
+
+//! \brief Traceback information of the dynamic programming table.
+//!
+//! Every cell takes one byte: for each of its three scores, two bits telling
+//! which score of the predecessor cell it comes from, plus one bit telling if
+//! its match score is zero.  Ties are broken as TraceBackActions does,
+//! preferring Match, then Insertion, then Deletion.
+class DirectionMatrix {
+ public:
+  enum State : uint8_t {
+    FromMatch     = 0,
+    FromInsertion = 1,
+    FromDeletion  = 2
+  };
+
+  //! \brief The bit set when the match score of the cell is zero.
+  static const uint8_t ZeroMatch = 1 << 6;
+
+  //! \brief Constructor
+  //! \param rows Number of rows
+  //! \param columns Number of columns
+  DirectionMatrix(size_t rows, size_t columns)
+      : rows_(rows), columns_(columns)
+      , bits_(new uint8_t[rows * columns]) {}
+
+  //! \brief Return the number of rows of the matrix
+  size_t rows() const { return rows_; }
+
+  //! \brief Return the number of columns of the matrix
+  size_t columns() const { return columns_; }
+
+  //! \brief Get the cell (i,j) of the matrix
+  uint8_t & operator()(size_t row, size_t column) const {
+    return bits_[row * columns_ + column];
+  }
+
+  //! \brief The score of the predecessor of the score state of (i,j).
+  State From(size_t i, size_t j, State state) const {
+    return From((*this)(i, j), state);
+  }
+
+  //! \brief Check if the match score of the cell (i,j) is zero.
+  bool MatchIsZero(size_t i, size_t j) const {
+    return ((*this)(i, j) & ZeroMatch) != 0;
+  }
+
+  //! \brief The score of the predecessor of the score state in bits.
+  static State From(uint8_t bits, State state) {
+    return State((bits >> (2 * state)) & 3);
+  }
+
+  //! \brief The directions of the boundary cell (i,j), with i == 0 or j == 0.
+  static uint8_t BoundaryDirections(size_t i, size_t j) {
+    if (i == 0 && j > 1) return FromInsertion << 2;
+    if (j == 0 && i > 1) return FromDeletion << 4;
+    return 0;
+  }
+
+  //! \brief The directions of the cell (i,j) once its scores are computed.
+  template <typename MatrixT>
+  static uint8_t Directions(
+      const ScoreTable & S, const MatrixT & M, size_t i, size_t j) {
+    const auto diagonal = M(i - 1, j - 1);
+    const auto up = M(i - 1, j);
+    const auto left = M(i, j - 1);
+
+    uint8_t bits =
+        Argmax(diagonal.Match, diagonal.Insertion, diagonal.Deletion) |
+        Argmax(left.Match + S.H + S.G, left.Insertion + S.G,
+               left.Deletion + S.H + S.G) << 2 |
+        Argmax(up.Match + S.H + S.G, up.Insertion + S.H + S.G,
+               up.Deletion + S.G) << 4;
+
+    if (M(i, j).Match == 0) bits |= ZeroMatch;
+
+    return bits;
+  }
+
+  //! \brief The state with the largest score, preferring Match, Insertion and
+  //! then Deletion.
+  static uint8_t Argmax(ssize_t match, ssize_t insertion, ssize_t deletion) {
+    if (match >= insertion && match >= deletion) return FromMatch;
+    if (insertion >= deletion) return FromInsertion;
+    return FromDeletion;
+  }
+
+ private:
+  size_t rows_;
+  size_t columns_;
+  std::unique_ptr<uint8_t[]> bits_;
+};
+
+//! \brief Check if the traceback ends entering the given state of (i,j).
+//!
+//! A gap may still reach a cell whose match score is zero, so only the match
+//! state of the cell starts a local alignment.
+template <typename DirectionsT>
+bool
+TraceBackStopCondition(const DirectionsT & T, size_t i, size_t j,
+                       DirectionMatrix::State state,
+                       const local_alignment_tag &) {
+  return i == 0 || j == 0 ||
+      (state == DirectionMatrix::FromMatch && T.MatchIsZero(i, j));
+}
+
+template <typename DirectionsT>
+bool
+TraceBackStopCondition(const DirectionsT &, size_t i, size_t j,
+                       DirectionMatrix::State, const global_alignment_tag &) {
+  return i == 0 && j == 0;
+}
+
+//! \brief Follow the directions from the cell (i,j) reached with action.
+//!
+//! \tparam DirectionsT A table with the interface of DirectionMatrix.
+//! \returns The alignment, the row and the column where it stops.
+template <typename algorithm_tag, typename DirectionsT>
+std::tuple<Cigar, size_t, size_t>
+TraceBackDirections(
+    const DirectionsT & T, size_t i, size_t j, Action action,
+    const Sequence & s1, const Sequence & s2) {
+  using State = DirectionMatrix::State;
+
+  auto move = [&](State state) {
+    if (state != DirectionMatrix::FromInsertion) --i;
+    if (state != DirectionMatrix::FromDeletion) --j;
+  };
+
+  State state =
+      action == Action::Insertion ? DirectionMatrix::FromInsertion
+      : action == Action::Deletion ? DirectionMatrix::FromDeletion
+      : DirectionMatrix::FromMatch;
+
+  Cigar actionStack;
+  // A local alignment without a positive score starts and ends at (0,0).
+  if (TraceBackStopCondition(T, i, j, state, algorithm_tag()))
+    return std::make_tuple(actionStack, i, j);
+
+  actionStack.push_back(action);
+
+  State from = T.From(i, j, state);
+  move(state);
+
+  while (!TraceBackStopCondition(T, i, j, from, algorithm_tag())) {
+    state = from;
+    from = T.From(i, j, state);
+
+    switch (state) {
+      case DirectionMatrix::FromMatch:
+        action = s1[i - 1] == s2[j - 1] ? Action::Match : Action::Mismatch;
+        break;
+      case DirectionMatrix::FromInsertion:
+        action = Action::Insertion;
+        break;
+      case DirectionMatrix::FromDeletion:
+        action = Action::Deletion;
+        break;
+    }
+
+    move(state);
+    actionStack.push_back(action);
+  }
+
+  return std::make_tuple(actionStack, i, j);
+}
+
+//! \brief The compact alignment procedure on scores of the given type.
+template <typename algorithm_tag, typename Score>
+Cigar
+BasicCompactAlignment(
+    const Sequence &s1, const Sequence &s2, const ScoreTable &S) {
+  using AlgorithmTrait = AlignmentAlgorithmTrait<algorithm_tag, Score>;
+  using Matrix = RollingMatrix<typename AlgorithmTrait::CellTy>;
+
+  Matrix M(s1.length() + 1, s2.length() + 1);
+  DirectionMatrix T(M.rows(), M.columns());
+
+  AlgorithmTrait::InitializeRow(S, M, 0);
+  for (size_t j = 0; j < T.columns(); ++j)
+    T(0, j) = DirectionMatrix::BoundaryDirections(0, j);
+
+  ScoreProfile P(s2, S);
+  std::tuple<size_t, size_t, ssize_t> best(0, 0, 0);
+  for (size_t i = 1; i < M.rows(); ++i) {
+    AlgorithmTrait::InitializeRow(S, M, i);
+    T(i, 0) = DirectionMatrix::BoundaryDirections(i, 0);
+    const auto scores = P.Row(s1[i-1]);
+    for (size_t j = 1; j < M.columns(); ++j) {
+      AlgorithmTrait::ComputeScore(S, M, i, j, scores[j-1]);
+      AlgorithmTrait::UpdateBestScore(M, i, j, best);
+      T(i, j) = DirectionMatrix::Directions(S, M, i, j);
+    }
+  }
+
+  // The last row of the scores is still available.
+  size_t startI, startJ, endI, endJ;
+  ssize_t score;
+  Action action;
+  std::tie(startI, startJ, score, action) =
+      AlgorithmTrait::GetFinalScoreAndAction(M, s1, s2, best);
+
+  Cigar actionStack;
+  std::tie(actionStack, endI, endJ) =
+      TraceBackDirections<algorithm_tag>(T, startI, startJ, action, s1, s2);
+
+  actionStack.SetCoordinates(s1.length(), s2.length(),
+                             endI, endJ, startI, startJ);
+
+  return actionStack;
+}
+
+//! \brief The compact alignment procedure.
+//!
+//! The scores are kept in two rolling rows while the table stores only the
+//! traceback directions, one byte per cell.  The alignment is the same of
+//! Alignment(s1, s2, S, algorithm_tag()).
+//!
+//! \param s1 The first sequence
+//! \param s2 The second sequence
+//! \param S  The score table
+//! \returns The alignment of s1 and s2
+template <typename algorithm_tag>
+Cigar
+CompactAlignment(const Sequence &s1, const Sequence &s2,
+                 const ScoreTable &S, const algorithm_tag &) {
+  return DispatchScoreType(
+      s1.length() + 1, s2.length() + 1, S,
+      [&](auto score) {
+        return BasicCompactAlignment<algorithm_tag, decltype(score)>(
+            s1, s2, S);
+      });
+}
+
+}  // namespace cpts571
+
+#endif  // COMPACT_ALIGNMENT_H
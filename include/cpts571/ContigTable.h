@@ -0,0 +1,83 @@
+//===------------------------------------------------------------*- C++ -*-===//
+//
+// Copyright 2017 Marco Minutoli <mminutoli@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License. You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef CONTIG_TABLE_H
+#define CONTIG_TABLE_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "cpts571/Sequence.h"
+
+namespace cpts571 {
+
+//! \brief The contigs of a reference concatenated in a single sequence.
+//!
+//! The contigs are separated by a character that does not occur in the reads,
+//! so that a substring matching a read never spans two contigs.  The table
+//! keeps where each contig begins, and translates a position of the
+//! concatenation to its contig with a binary search.
+class ContigTable {
+ public:
+  //! \brief Append a contig to the concatenation.
+  //! \param reference The concatenation of the contigs added so far
+  //! \param name The name of the contig
+  //! \param contig The contig
+  void Append(Sequence & reference, const std::string & name,
+              const Sequence & contig) {
+    if (!begins_.empty()) {
+      std::string separator("#");
+      reference.AppendChunk(separator.begin(), separator.end());
+    }
+
+    names_.push_back(name);
+    begins_.push_back(reference.length());
+    lengths_.push_back(contig.length());
+    reference.AppendChunk(contig.begin(), contig.end());
+  }
+
+  //! \brief The number of contigs.
+  size_t size() const { return begins_.size(); }
+
+  //! \brief The contig holding the position pos of the concatenation, or
+  //! preceding it when pos is a separator.
+  size_t Find(size_t pos) const {
+    return std::upper_bound(begins_.begin(), begins_.end(), pos) -
+        begins_.begin() - 1;
+  }
+
+  const std::string & Name(size_t i) const { return names_[i]; }
+  size_t Length(size_t i) const { return lengths_[i]; }
+
+  //! \brief The first position of the contig in the concatenation.
+  size_t Begin(size_t i) const { return begins_[i]; }
+
+  //! \brief One past the last position of the contig in the concatenation.
+  size_t End(size_t i) const { return begins_[i] + lengths_[i]; }
+
+ private:
+  std::vector<std::string> names_;
+  std::vector<size_t> begins_;
+  std::vector<size_t> lengths_;
+};
+
+}  // namespace cpts571
+
+#endif  // CONTIG_TABLE_H
@@ -0,0 +1,156 @@
+//===------------------------------------------------------------*- C++ -*-===//
+//
+// Copyright 2017 Marco Minutoli <mminutoli@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License. You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef EDIT_DISTANCE_H
+#define EDIT_DISTANCE_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "cpts571/Sequence.h"
+
+namespace cpts571 {
+
+//! \brief Bit-parallel edit distance of a pattern against a text (Myers).
+//!
+//! The columns of the edit distance table are encoded as bit vectors of
+//! vertical deltas, in blocks of 64 rows, and each character of the text
+//! updates them with a constant number of word operations per block
+//! (Hyyrö's formulation of the algorithm of Myers).  The pattern is encoded
+//! once and reused for every text.
+class BitParallelPattern {
+ public:
+  using Word = uint64_t;
+  static constexpr size_t WordBits = 64;
+
+  //! \brief Constructor
+  //! \param pattern The pattern to search
+  explicit BitParallelPattern(const Sequence & pattern)
+      : length_(pattern.length())
+      , blocks_((pattern.length() + WordBits - 1) / WordBits)
+      , index_()
+      , equal_(blocks_, 0) {
+    index_.fill(0);
+    for (size_t i = 0; i < length_; ++i) {
+      uint8_t c = pattern[i];
+      if (index_[c] == 0) {
+        index_[c] = equal_.size() / blocks_;
+        equal_.resize(equal_.size() + blocks_, 0);
+      }
+      equal_[index_[c] * blocks_ + i / WordBits] |= Word(1) << (i % WordBits);
+    }
+  }
+
+  //! \brief Return the length of the pattern
+  size_t length() const { return length_; }
+
+  //! \brief The smallest edit distance of the pattern to a substring of the
+  //! text [B, E).
+  template <typename Iterator>
+  size_t SemiGlobalDistance(Iterator B, Iterator E) const {
+    return ScanDistance(B, E, 0);
+  }
+
+  //! \brief Check if the pattern is within k edits from a substring of the
+  //! text [B, E).  The text is scanned only up to the first such substring.
+  template <typename Iterator>
+  bool WithinDistance(Iterator B, Iterator E, size_t k) const {
+    return ScanDistance(B, E, k) <= k;
+  }
+
+ private:
+  //! \brief The smallest edit distance up to the first one not above stop.
+  template <typename Iterator>
+  size_t ScanDistance(Iterator B, Iterator E, size_t stop) const {
+    if (blocks_ == 0) return 0;
+
+    std::vector<Word> Pv(blocks_, ~Word(0));
+    std::vector<Word> Mv(blocks_, 0);
+    const Word last = Word(1) << ((length_ - 1) % WordBits);
+
+    size_t score = length_;
+    size_t best = score;
+    for (; B != E && best > stop; ++B) {
+      const Word *Eq = &equal_[index_[uint8_t(*B)] * blocks_];
+
+      // The first row is zero: the pattern can start anywhere in the text.
+      int carry = 0;
+      for (size_t b = 0; b < blocks_; ++b) {
+        const Word high = b + 1 == blocks_ ? last : Word(1) << (WordBits - 1);
+        carry = AdvanceBlock(Pv[b], Mv[b], Eq[b], carry, high);
+      }
+
+      score += carry;
+      best = std::min(best, score);
+    }
+
+    return best;
+  }
+
+  //! \brief Move a block of rows to the next column.
+  //!
+  //! \param carry The horizontal delta entering the block from above.
+  //! \returns The horizontal delta leaving the block at the row high.
+  static int
+  AdvanceBlock(Word & Pv, Word & Mv, Word Eq, int carry, Word high) {
+    Word Xv = Eq | Mv;
+    if (carry < 0) Eq |= 1;
+    Word Xh = (((Eq & Pv) + Pv) ^ Pv) | Eq;
+    Word Ph = Mv | ~(Xh | Pv);
+    Word Mh = Pv & Xh;
+
+    int out = (Ph & high) ? 1 : (Mh & high) ? -1 : 0;
+
+    Ph <<= 1;
+    Mh <<= 1;
+    if (carry < 0) Mh |= 1;
+    else if (carry > 0) Ph |= 1;
+
+    Pv = Mh | ~(Xv | Ph);
+    Mv = Ph & Xv;
+    return out;
+  }
+
+  size_t length_;
+  size_t blocks_;
+  std::array<size_t, 256> index_;
+  std::vector<Word> equal_;
+};
+
+//! \brief The largest edit distance of a read to a window that can still
+//! contain an alignment with the given identity and coverage.
+//!
+//! An alignment of L = matches + insertions + deletions columns with identity
+//! X and coverage Y extends to an alignment of the whole read with at most
+//! |r| - matches + deletions <= |r| + L (1 - 2X) edits, and L >= Y |r|.
+//!
+//! \param readLength The length of the read
+//! \param X The minimum identity
+//! \param Y The minimum coverage
+inline size_t
+EditDistanceBound(size_t readLength, double X, double Y) {
+  // Keep the rounding errors of the bound from rejecting a window on it.
+  return readLength * (1.0 + Y * std::min(0.0, 1.0 - 2.0 * X)) + 1e-9;
+}
+
+}  // namespace cpts571
+
+#endif  // EDIT_DISTANCE_H
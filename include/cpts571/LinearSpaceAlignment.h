@@ -0,0 +1,350 @@
+//===------------------------------------------------------------*- C++ -*-===//
+//
+// Copyright 2017 Marco Minutoli <mminutoli@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License. You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef LINEAR_SPACE_ALIGNMENT_H
+#define LINEAR_SPACE_ALIGNMENT_H
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+#include "cpts571/Alignment.h"
+#include "cpts571/Sequence.h"
+
+namespace cpts571 {
+
+struct linear_space_global_alignment_tag {};
+struct linear_space_local_alignment_tag {};
+
+//! \brief Global alignment with affine gaps in linear space.
+//!
+//! Divide and conquer procedure of Myers and Miller ("Optimal alignments in
+//! linear space", 1988).  Every level of the recursion computes the last row
+//! of the forward and of the reverse problem using O(n) memory and splits the
+//! problem where the two halves meet.  A split that falls inside a deletion
+//! gap is handled by forcing the two deletions around the middle row and by
+//! not charging the opening of the gap in the two sub-problems.
+class MyersMillerAligner {
+ public:
+  //! \brief Constructor
+  //! \param s1 The first sequence
+  //! \param s2 The second sequence
+  //! \param S  The score table
+  MyersMillerAligner(
+      const Sequence &s1, const Sequence &s2, const ScoreTable &S)
+      : s1_(s1), s2_(s2), S_(S), P_(s2, S)
+      , CC_(s2.length() + 1), DD_(s2.length() + 1)
+      , RR_(s2.length() + 1), SS_(s2.length() + 1)
+      , script_()
+  {}
+
+  //! \brief Run the alignment procedure.
+  //! \returns The alignment of s1 and s2
+  Cigar Align() { return Align(0, s1_.length(), 0, s2_.length()); }
+
+  //! \brief Run the alignment procedure on a part of the two sequences.
+  //! \returns The alignment of s1[begin1, end1) and s2[begin2, end2)
+  Cigar Align(size_t begin1, size_t end1, size_t begin2, size_t end2) {
+    script_.clear();
+    script_.reserve((end1 - begin1) + (end2 - begin2));
+    Diff(begin1, end1 - begin1, begin2, end2 - begin2, S_.H, S_.H);
+
+    Cigar cigar;
+    for (auto itr = script_.rbegin(), end = script_.rend(); itr != end; ++itr)
+      cigar.push_back(*itr);
+    cigar.SetCoordinates(s1_.length(), s2_.length(),
+                         begin1, begin2, end1, end2);
+    return cigar;
+  }
+
+ private:
+  ssize_t Gap(size_t k) const { return k == 0 ? 0 : S_.H + k * S_.G; }
+
+  ssize_t W(size_t i, size_t j) const { return P_.Row(s1_[i])[j]; }
+
+  //! \brief The scores of s1[i] against s2, read once per row.
+  const ScoreProfile::ScoreTy * Row(size_t i) const { return P_.Row(s1_[i]); }
+
+  void Insert(size_t k) { script_.insert(script_.end(), k, Action::Insertion); }
+
+  void Delete(size_t k) { script_.insert(script_.end(), k, Action::Deletion); }
+
+  void Replace(size_t i, size_t j) {
+    script_.push_back(s1_[i] == s2_[j] ? Action::Match : Action::Mismatch);
+  }
+
+  //! \brief Align s1[i0, i0 + M) to s2[j0, j0 + N).
+  //!
+  //! \param tb The opening cost of a deletion gap starting the alignment.
+  //! \param te The opening cost of a deletion gap ending the alignment.
+  void Diff(size_t i0, size_t M, size_t j0, size_t N, ssize_t tb, ssize_t te);
+
+  //! \brief Last row of the forward problem on the first imid rows.
+  void Forward(size_t i0, size_t imid, size_t j0, size_t N, ssize_t tb);
+
+  //! \brief First row of the reverse problem on the rows [imid, M).
+  void Reverse(size_t i0, size_t imid, size_t M, size_t j0, size_t N,
+               ssize_t te);
+
+  const Sequence &s1_;
+  const Sequence &s2_;
+  const ScoreTable &S_;
+  ScoreProfile P_;
+
+  std::vector<ssize_t> CC_;
+  std::vector<ssize_t> DD_;
+  std::vector<ssize_t> RR_;
+  std::vector<ssize_t> SS_;
+  std::vector<Action> script_;
+};
+
+inline void
+MyersMillerAligner::Forward(
+    size_t i0, size_t imid, size_t j0, size_t N, ssize_t tb) {
+  ssize_t t = S_.H;
+  CC_[0] = 0;
+  for (size_t j = 1; j <= N; ++j) {
+    t += S_.G;
+    CC_[j] = t;
+    DD_[j] = t + S_.H;
+  }
+
+  t = tb;
+  for (size_t i = 1; i <= imid; ++i) {
+    ssize_t s = CC_[0];
+    t += S_.G;
+    ssize_t c = t;
+    ssize_t e = t + S_.H;
+    CC_[0] = c;
+    const auto scores = Row(i0 + i - 1) + j0;
+    for (size_t j = 1; j <= N; ++j) {
+      e = std::max(e, c + S_.H) + S_.G;
+      ssize_t d = std::max(DD_[j], CC_[j] + S_.H) + S_.G;
+      c = std::max(std::max(d, e), s + scores[j - 1]);
+      s = CC_[j];
+      CC_[j] = c;
+      DD_[j] = d;
+    }
+  }
+  DD_[0] = CC_[0];
+}
+
+inline void
+MyersMillerAligner::Reverse(
+    size_t i0, size_t imid, size_t M, size_t j0, size_t N, ssize_t te) {
+  ssize_t t = S_.H;
+  RR_[N] = 0;
+  for (size_t j = N; j-- > 0;) {
+    t += S_.G;
+    RR_[j] = t;
+    SS_[j] = t + S_.H;
+  }
+
+  t = te;
+  for (size_t i = M; i-- > imid;) {
+    ssize_t s = RR_[N];
+    t += S_.G;
+    ssize_t c = t;
+    ssize_t e = t + S_.H;
+    RR_[N] = c;
+    const auto scores = Row(i0 + i) + j0;
+    for (size_t j = N; j-- > 0;) {
+      e = std::max(e, c + S_.H) + S_.G;
+      ssize_t d = std::max(SS_[j], RR_[j] + S_.H) + S_.G;
+      c = std::max(std::max(d, e), s + scores[j]);
+      s = RR_[j];
+      RR_[j] = c;
+      SS_[j] = d;
+    }
+  }
+  SS_[N] = RR_[N];
+}
+
+inline void
+MyersMillerAligner::Diff(
+    size_t i0, size_t M, size_t j0, size_t N, ssize_t tb, ssize_t te) {
+  if (N == 0) {
+    Delete(M);
+    return;
+  }
+
+  if (M == 0) {
+    Insert(N);
+    return;
+  }
+
+  if (M == 1) {
+    // Either s1[i0] is deleted, merging with the cheapest of the two
+    // surrounding deletion gaps, or it is paired with one of the s2[j].
+    ssize_t best = std::max(tb, te) + S_.G + Gap(N);
+    size_t midj = 0;
+    for (size_t j = 1; j <= N; ++j) {
+      ssize_t c = Gap(j - 1) + W(i0, j0 + j - 1) + Gap(N - j);
+      if (c > best) {
+        best = c;
+        midj = j;
+      }
+    }
+
+    if (midj == 0) {
+      if (tb >= te) {
+        Delete(1);
+        Insert(N);
+      } else {
+        Insert(N);
+        Delete(1);
+      }
+    } else {
+      Insert(midj - 1);
+      Replace(i0, j0 + midj - 1);
+      Insert(N - midj);
+    }
+    return;
+  }
+
+  size_t imid = M / 2;
+  Forward(i0, imid, j0, N, tb);
+  Reverse(i0, imid, M, j0, N, te);
+
+  // Type 1: the optimal path crosses row imid at (imid, midj).
+  // Type 2: the optimal path crosses row imid inside a deletion gap.
+  ssize_t midc = CC_[0] + RR_[0];
+  size_t midj = 0;
+  bool insideGap = false;
+  for (size_t j = 0; j <= N; ++j) {
+    ssize_t c = CC_[j] + RR_[j];
+    if (c > midc || (c == midc && CC_[j] != DD_[j] && RR_[j] == SS_[j])) {
+      midc = c;
+      midj = j;
+    }
+  }
+  for (size_t j = N + 1; j-- > 0;) {
+    ssize_t c = DD_[j] + SS_[j] - S_.H;
+    if (c > midc) {
+      midc = c;
+      midj = j;
+      insideGap = true;
+    }
+  }
+
+  if (!insideGap) {
+    Diff(i0, imid, j0, midj, tb, S_.H);
+    Diff(i0 + imid, M - imid, j0 + midj, N - midj, S_.H, te);
+  } else {
+    Diff(i0, imid - 1, j0, midj, tb, 0);
+    Delete(2);
+    Diff(i0 + imid + 1, M - imid - 1, j0 + midj, N - midj, 0, te);
+  }
+}
+
+//! \brief The linear space global alignment procedure.
+//!
+//! \param s1 The first sequence
+//! \param s2 The second sequence
+//! \param S  The score table
+//! \returns The alignment of s1 and s2
+inline Cigar
+Alignment(const Sequence &s1, const Sequence &s2,
+          ScoreTable &S, const linear_space_global_alignment_tag &) {
+  MyersMillerAligner aligner(s1, s2, S);
+  return aligner.Align();
+}
+
+//! \brief Find where an optimal local alignment ending at (endI, endJ)
+//! starts.
+//!
+//! The scores of the global alignments of s1[i, endI) and s2[j, endJ) are
+//! computed backwards from the end cell keeping one row, until one of them
+//! reaches the optimal score.
+//!
+//! \param score The optimal local score, ending at (endI, endJ)
+//! \returns The cell (i,j) where the alignment starts
+inline std::tuple<size_t, size_t>
+LocalAlignmentStart(const Sequence &s1, const Sequence &s2,
+                    const ScoreTable &S,
+                    size_t endI, size_t endJ, ssize_t score) {
+  ScoreProfile P(s2, S);
+  std::vector<ssize_t> RR(endJ + 1);
+  std::vector<ssize_t> SS(endJ + 1);
+
+  ssize_t t = S.H;
+  RR[endJ] = 0;
+  for (size_t j = endJ; j-- > 0;) {
+    t += S.G;
+    RR[j] = t;
+    SS[j] = t + S.H;
+  }
+
+  t = S.H;
+  for (size_t i = endI; i-- > 0;) {
+    ssize_t s = RR[endJ];
+    t += S.G;
+    ssize_t c = t;
+    ssize_t e = t + S.H;
+    RR[endJ] = c;
+    const auto scores = P.Row(s1[i]);
+    for (size_t j = endJ; j-- > 0;) {
+      e = std::max(e, c + S.H) + S.G;
+      ssize_t d = std::max(SS[j], RR[j] + S.H) + S.G;
+      c = std::max(std::max(d, e), s + scores[j]);
+      s = RR[j];
+      RR[j] = c;
+      SS[j] = d;
+      if (c == score) return std::make_tuple(i, j);
+    }
+  }
+
+  return std::make_tuple(endI, endJ);
+}
+
+//! \brief The linear space local alignment procedure.
+//!
+//! The cell where an optimal local alignment ends is found keeping two rows
+//! of the table and the one where it starts walking back from it.  The part
+//! of s1 and s2 between the two cells is then aligned globally in linear
+//! space, with the same optimal score.
+//!
+//! \param s1 The first sequence
+//! \param s2 The second sequence
+//! \param S  The score table
+//! \returns The alignment of s1 and s2
+inline Cigar
+Alignment(const Sequence &s1, const Sequence &s2,
+          ScoreTable &S, const linear_space_local_alignment_tag &) {
+  size_t startI, startJ, endI, endJ;
+  ssize_t score;
+  std::tie(endI, endJ, score) =
+      AlignmentScore(s1, s2, S, local_alignment_tag());
+
+  if (score == 0) {
+    Cigar cigar;
+    cigar.SetCoordinates(s1.length(), s2.length(), 0, 0, 0, 0);
+    return cigar;
+  }
+
+  std::tie(startI, startJ) =
+      LocalAlignmentStart(s1, s2, S, endI, endJ, score);
+
+  MyersMillerAligner aligner(s1, s2, S);
+  return aligner.Align(startI, endI, startJ, endJ);
+}
+
+}  // namespace cpts571
+
+#endif  // LINEAR_SPACE_ALIGNMENT_H
@@ -19,15 +19,35 @@
 #ifndef READ_MAPPING_DRIVER_H
 #define READ_MAPPING_DRIVER_H
 
+#include <ostream>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include "cpts571/Alignment.h"
+#include "cpts571/ContigTable.h"
 #include "cpts571/Sequence.h"
 #include "cpts571/SuffixTree.h"
 
 namespace cpts571 {
 
+//! \brief The procedure used to align the reads to the candidate locations.
+enum class AlignerKind {
+  Full,    //< Local alignment of the whole window
+  Banded,  //< Local alignment in a band around the seed diagonal
+  Striped, //< Local alignment of the whole window with the striped kernel
+  XDrop,   //< X-drop extension of the seed to its left and to its right
+  Batched, //< Local alignment of the whole window, many windows per vector
+  SemiGlobal //< The whole read aligned to a substring of the window
+};
+
+//! \brief The format of the mapping results.
+enum class OutputFormat {
+  Native, //< The name of the read, its contig and where it starts and ends
+  SAM,    //< The Sequence Alignment/Map format
+  PAF     //< The Pairwise mApping Format of minimap2
+};
+
 struct ReadMappingDriverConfiguration {
   std::string GeneFileName;
   std::string ReadsFileName;
@@ -35,13 +55,40 @@ struct ReadMappingDriverConfiguration {
   size_t x;
   double X;
   double Y;
+  AlignerKind Aligner;
+  size_t BandWidth;
+  ssize_t XDrop;
+  bool Prefilter;
+  //! Map also the reverse complement of the reads.
+  bool BothStrands;
+  //! The maximum number of windows aligned per strand of a read, 0 for all.
+  size_t MaxCandidates;
+  //! The bases of FASTQ reads with a lower Phred quality are masked, 0 for
+  //! none.
+  size_t MinQuality;
+  size_t Threads;
+  size_t SeedThreads;
+  size_t BatchSize;
+  OutputFormat Format;
+  //! The file receiving the mapping results, the standard output if empty.
+  std::string OutputFileName;
 };
 
+//! \brief Map reads to a gene, or to the contigs of a reference.
+//!
+//! All the records of the reference file are indexed by a single suffix tree
+//! and the mappings are reported on their contig.
+//!
+//! The reads flow through a pipeline of concurrent stages connected by
+//! bounded queues of batches of reads: a reader parsing the reads file, the
+//! seeding workers finding the candidate locations on the suffix tree, the
+//! verification workers aligning the reads to them, and a writer printing the
+//! batches in the order of the file.
 class ReadMappingDriver {
  public:
   ReadMappingDriver(const ReadMappingDriverConfiguration & C)
       : gene_()
-      , reads_()
+      , contigs_()
       , config_(C)
   {
     Parse(config_.GeneFileName, config_.ReadsFileName, config_.CFileName);
@@ -52,9 +99,113 @@ class ReadMappingDriver {
   void Exec();
 
  private:
-  ScoreTable scoreTable_{ +1, -2, -5, -1 };
+  //! \brief The statistics of the reads mapped so far.
+  struct MappingStats {
+    double readsWithMatches = 0;
+    double totNumberOfMatches = 0;
+    //! The locations of the seeds, before they are merged in windows.
+    size_t seedLocations = 0;
+    //! The windows left out by the cap on the candidates.
+    size_t droppedCandidates = 0;
+    //! The windows matching the read exactly, or without gaps, and aligned
+    //! without dynamic programming.
+    size_t exactAlignments = 0;
+    size_t ungappedAlignments = 0;
+    //! The windows that could not beat the best alignment of their read.
+    size_t prunedCandidates = 0;
+    //! The bases below the minimum quality, masked or cut from the tails.
+    size_t maskedBases = 0;
+    size_t trimmedBases = 0;
+    size_t skippedAlignments = 0;
+    double PrefilterTime = 0;
+
+    MappingStats & operator+=(const MappingStats & other);
+  };
+
+  //! \brief The best alignment of a read.
+  struct ReadMapping {
+    //! The position of the read on the gene, -1 if not found.
+    ssize_t position = -1;
+    //! The position of the window of the alignment on the gene.
+    size_t window = 0;
+    //! Whether the reverse complement of the read is aligned.
+    bool reverse = false;
+    //! The alignment of the window and of the read.
+    Cigar alignment;
+    ssize_t score = 0;
+  };
+
+  //! \brief A window of the gene where a read is aligned.
+  struct Candidate {
+    size_t begin;
+    size_t end;
+    //! The location of the first seed in the window.
+    size_t location;
+    //! The number of seed locations merged in the window.
+    size_t hits;
+    //! The first of its locations in the order of the suffix tree.
+    size_t rank;
+  };
+
+  //! \brief The candidate windows of a strand of a read.
+  struct ReadSeeds {
+    std::vector<Candidate> candidates;
+    //! The offset and the length of the seed in the read.
+    size_t offset = 0;
+    size_t length = 0;
+  };
+
+  //! \brief A batch of reads flowing through the stages.
+  struct ReadBatch {
+    //! The position of the batch in the reads file.
+    size_t id = 0;
+    std::vector<Sequence> reads;
+    //! The reads with their low quality bases masked and their low quality
+    //! tail cut, when the qualities are used.
+    std::vector<Sequence> masked;
+    std::vector<ReadSeeds> seeds;
+    //! The reverse complement of the reads, and their candidate windows.
+    std::vector<Sequence> reverse;
+    std::vector<ReadSeeds> reverseSeeds;
+    std::vector<ReadMapping> result;
+    MappingStats stats;
+
+    //! \brief The reads as they are seeded and aligned.
+    const std::vector<Sequence> & Aligned() const {
+      return masked.empty() ? reads : masked;
+    }
+  };
+
+  //! \brief Merge the seed locations of a read in the windows to align.
+  ReadSeeds Consolidate(
+      const std::tuple<std::vector<size_t>, size_t, size_t> & seed,
+      size_t readLength, MappingStats & stats) const;
+
+  //! \brief The read r with its bases below the minimum quality masked and
+  //! its low quality tail cut.
+  Sequence MaskLowQuality(const Sequence & r, MappingStats & stats) const;
+
+  void SeedReads(const SuffixTree & ST, ReadBatch & batch) const;
+
+  //! \brief Align r to the gene on the diagonal where it starts at start.
+  //! \param allowMismatches false when another diagonal of the window might
+  //! score better, so that only an exact match is certainly optimal.
+  //! \returns false if an alignment with gaps might score better.
+  bool UngappedAlignment(const Sequence & r, size_t start,
+                         bool allowMismatches, Cigar & alignment) const;
+
+  void VerifyReads(ReadBatch & batch);
+
+  //! \brief Append the header of the output format to O.
+  void PrintHeader(std::ostream & O) const;
+
+  //! \brief Append the mappings of the batch to O.
+  void PrintResults(const ReadBatch & batch, std::ostream & O) const;
+
+  ScoreTable scoreTable_{ +1, -2, -5, -1, nullptr };
+  //! The contigs of the reference, concatenated.
   Sequence gene_;
-  std::vector<Sequence> reads_;
+  ContigTable contigs_;
   ReadMappingDriverConfiguration config_;
 };
 
@@ -20,8 +20,10 @@
 #ifndef SEQUENCE_H
 #define SEQUENCE_H
 
+#include <algorithm>
 #include <string>
 #include <ostream>
+#include <utility>
 
 namespace cpts571 {
 
@@ -33,6 +35,11 @@ class Sequence {
   void Name(const std::string & n) { sequenceName_ = n; }
   std::string Name() const { return sequenceName_; }
 
+  //! \brief The Phred+33 qualities of the characters, empty when the
+  //! sequence comes from a FASTA file.
+  void Quality(std::string q) { quality_ = std::move(q); }
+  const std::string & Quality() const { return quality_; }
+
   template <typename Iterator>
   void AppendChunk(const Iterator B, const Iterator E) {
     sequence_.insert(std::end(sequence_), B, E);
@@ -61,8 +68,42 @@ class Sequence {
  private:
   std::string sequenceName_;
   std::string sequence_;
+  std::string quality_;
 };
 
+//! \brief The complement of a nucleotide, or of an IUPAC ambiguity code.
+inline char Complement(char c) {
+  switch (c) {
+    case 'A': return 'T'; case 'a': return 't';
+    case 'C': return 'G'; case 'c': return 'g';
+    case 'G': return 'C'; case 'g': return 'c';
+    case 'T': return 'A'; case 't': return 'a';
+    case 'U': return 'A'; case 'u': return 'a';
+    case 'R': return 'Y'; case 'r': return 'y';
+    case 'Y': return 'R'; case 'y': return 'r';
+    case 'K': return 'M'; case 'k': return 'm';
+    case 'M': return 'K'; case 'm': return 'k';
+    case 'B': return 'V'; case 'b': return 'v';
+    case 'V': return 'B'; case 'v': return 'b';
+    case 'D': return 'H'; case 'd': return 'h';
+    case 'H': return 'D'; case 'h': return 'd';
+    default: return c;
+  }
+}
+
+//! \brief The sequence of the opposite strand, read in its own direction.
+inline Sequence ReverseComplement(const Sequence & S) {
+  std::string reverse(S.begin(), S.end());
+  std::reverse(reverse.begin(), reverse.end());
+  for (auto & c : reverse) c = Complement(c);
+
+  Sequence result;
+  result.Name(S.Name());
+  result.AppendChunk(reverse.begin(), reverse.end());
+  result.Quality(std::string(S.Quality().rbegin(), S.Quality().rend()));
+  return result;
+}
+
 }
 
 #endif /* SEQUENCE_H */
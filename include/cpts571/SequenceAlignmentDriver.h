@@ -21,6 +21,7 @@
 #define SEQUENCE_ALIGNMENT_DRIVER_H
 
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include "cpts571/Alignment.h"
@@ -31,25 +32,53 @@
 
 namespace cpts571 {
 
+//! \brief The pairs of sequences of the input file to align.
+enum class AlignmentPairs {
+  Single,    //!< The two sequences of the file.
+  All,       //!< Every pair of sequences.
+  OneVsAll,  //!< The first sequence against each of the others.
+};
+
 struct SequenceAlignmentDriverConfiguration {
   std::string IFileName;
   bool Global;
   std::string CFileName;
+  size_t MemoryBudget;
+  bool ScoreOnly;
+  size_t Threads;
+  bool WFA;
+  AlignmentPairs Pairs;
+  bool Matrix;
 };
 
 class SequenceAlignmentDriver {
  public:
   SequenceAlignmentDriver(const SequenceAlignmentDriverConfiguration & C)
       : sequences_()
-      , S_{ 1, -2, -5, -2 }
+      , S_{ 1, -2, -5, -2, nullptr }
       , isGlobal_(C.Global)
-      , actions_()
+      , memoryBudget_(C.MemoryBudget)
+      , scoreOnly_(C.ScoreOnly)
+      , threads_(C.Threads)
+      , wfa_(C.WFA)
+      , pairs_(C.Pairs)
+      , matrix_(C.Matrix)
+      , alignment_()
+      , score_()
   {
     Parse(C.IFileName, C.CFileName);
   }
 
   void AlignSequences();
 
+  //! \brief Align the pairs of sequences of the input file in parallel.
+  //!
+  //! The pairs are scheduled from the largest table to the smallest on a
+  //! work-stealing pool of threads and their summaries are printed as soon as
+  //! they are done.  With the score matrix, every row is printed once all the
+  //! pairs involving its sequence and the rows before it are done.
+  void AlignPairs();
+
   void Print();
 
 private:
@@ -58,7 +87,14 @@ private:
   std::vector<Sequence> sequences_;
   ScoreTable S_;
   bool isGlobal_;
-  std::deque<Action> actions_;
+  size_t memoryBudget_;
+  bool scoreOnly_;
+  size_t threads_;
+  bool wfa_;
+  AlignmentPairs pairs_;
+  bool matrix_;
+  Cigar alignment_;
+  std::tuple<size_t, size_t, ssize_t> score_;
 };
 
 }
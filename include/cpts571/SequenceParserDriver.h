@@ -20,6 +20,7 @@
 #ifndef SEQUENCE_PARSER_DRIVER_H
 #define SEQUENCE_PARSER_DRIVER_H
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -36,13 +37,29 @@ class SequenceParserDriver {
       : inputFileName_(inputFileName)
   {}
 
+  //! \brief Parse the input file, exiting when it is unreadable or
+  //! malformed.
   std::vector<Sequence> Parse();
 
-  void AddSequence(Sequence & s) { sequences_.emplace_back(std::move(s)); }
+  //! \brief Parse the input file passing every sequence to consumer as soon
+  //! as it is read, instead of keeping all of them.
+  //! \returns false when the file is unreadable or malformed, after passing
+  //! the sequences before the error.
+  bool Parse(const std::function<void(Sequence &)> & consumer);
+
+  void AddSequence(Sequence & s) {
+    if (consumer_)
+      consumer_(s);
+    else
+      sequences_.emplace_back(std::move(s));
+  }
 
  private:
+  bool Run();
+
   std::string inputFileName_;
   std::vector<Sequence> sequences_;
+  std::function<void(Sequence &)> consumer_;
 };
 
 }
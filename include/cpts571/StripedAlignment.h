@@ -0,0 +1,580 @@
+//===------------------------------------------------------------*- C++ -*-===//
+//
+// Copyright 2017 Marco Minutoli <mminutoli@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License. You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef STRIPED_ALIGNMENT_H
+#define STRIPED_ALIGNMENT_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "cpts571/Alignment.h"
+#include "cpts571/Sequence.h"
+
+namespace cpts571 {
+
+#if defined(__AVX2__)
+
+//! \brief Saturating unsigned 8-bit lanes.
+//!
+//! All the scores are kept non negative.
+struct StripedU8Ops {
+  using Vec = __m256i;
+  using Elem = uint8_t;
+  static constexpr size_t Lanes = 32;
+  static constexpr ssize_t MaxValue = 255;
+
+  static Vec Load(const Elem *p) {
+    return _mm256_loadu_si256(reinterpret_cast<const Vec *>(p));
+  }
+  static void Store(Elem *p, Vec v) {
+    _mm256_storeu_si256(reinterpret_cast<Vec *>(p), v);
+  }
+  static Vec Set1(ssize_t x) { return _mm256_set1_epi8(char(x)); }
+  static Vec Zero() { return _mm256_setzero_si256(); }
+  static Vec Min() { return Zero(); }
+  static Vec Adds(Vec a, Vec b) { return _mm256_adds_epu8(a, b); }
+  static Vec Subs(Vec a, Vec b) { return _mm256_subs_epu8(a, b); }
+  static Vec SubsGap(Vec a, Vec b) { return Subs(a, b); }
+  static Vec Max(Vec a, Vec b) { return _mm256_max_epu8(a, b); }
+  static Vec ShiftLeft(Vec v) {
+    return _mm256_alignr_epi8(v, _mm256_permute2x128_si256(v, v, 0x08), 15);
+  }
+  static bool AnyGreater(Vec a, Vec b) {
+    Vec d = _mm256_subs_epu8(a, b);
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(d, Zero())) != -1;
+  }
+};
+
+//! \brief Saturating signed 16-bit lanes.
+//!
+//! Match scores are kept non negative, gap scores keep their exact value.
+struct StripedI16Ops {
+  using Vec = __m256i;
+  using Elem = int16_t;
+  static constexpr size_t Lanes = 16;
+  static constexpr ssize_t MaxValue = std::numeric_limits<int16_t>::max();
+
+  static Vec Load(const Elem *p) {
+    return _mm256_loadu_si256(reinterpret_cast<const Vec *>(p));
+  }
+  static void Store(Elem *p, Vec v) {
+    _mm256_storeu_si256(reinterpret_cast<Vec *>(p), v);
+  }
+  static Vec Set1(ssize_t x) { return _mm256_set1_epi16(int16_t(x)); }
+  static Vec Zero() { return _mm256_setzero_si256(); }
+  static Vec Min() {
+    return _mm256_set1_epi16(std::numeric_limits<int16_t>::min());
+  }
+  static Vec Adds(Vec a, Vec b) { return _mm256_adds_epi16(a, b); }
+  static Vec Subs(Vec a, Vec b) {
+    return _mm256_max_epi16(_mm256_subs_epi16(a, b), Zero());
+  }
+  static Vec SubsGap(Vec a, Vec b) { return _mm256_subs_epi16(a, b); }
+  static Vec Max(Vec a, Vec b) { return _mm256_max_epi16(a, b); }
+  static Vec ShiftLeft(Vec v) {
+    return _mm256_alignr_epi8(v, _mm256_permute2x128_si256(v, v, 0x08), 14);
+  }
+  static bool AnyGreater(Vec a, Vec b) {
+    return _mm256_movemask_epi8(_mm256_cmpgt_epi16(a, b)) != 0;
+  }
+  static Vec Greater(Vec a, Vec b) { return _mm256_cmpgt_epi16(a, b); }
+  static Vec Equal(Vec a, Vec b) { return _mm256_cmpeq_epi16(a, b); }
+  static Vec Or(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+  static Vec Select(Vec mask, Vec a, Vec b) {
+    return _mm256_blendv_epi8(b, a, mask);
+  }
+  //! Store the lanes, all in [0, 128), one byte each.
+  static void StoreBytes(uint8_t *p, Vec v) {
+    Vec packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0x08);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p),
+                     _mm256_castsi256_si128(packed));
+  }
+};
+
+#define CPTS571_STRIPED_ALIGNMENT 1
+
+#elif defined(__SSE2__)
+
+//! \brief Saturating unsigned 8-bit lanes.
+//!
+//! All the scores are kept non negative.
+struct StripedU8Ops {
+  using Vec = __m128i;
+  using Elem = uint8_t;
+  static constexpr size_t Lanes = 16;
+  static constexpr ssize_t MaxValue = 255;
+
+  static Vec Load(const Elem *p) {
+    return _mm_loadu_si128(reinterpret_cast<const Vec *>(p));
+  }
+  static void Store(Elem *p, Vec v) {
+    _mm_storeu_si128(reinterpret_cast<Vec *>(p), v);
+  }
+  static Vec Set1(ssize_t x) { return _mm_set1_epi8(char(x)); }
+  static Vec Zero() { return _mm_setzero_si128(); }
+  static Vec Min() { return Zero(); }
+  static Vec Adds(Vec a, Vec b) { return _mm_adds_epu8(a, b); }
+  static Vec Subs(Vec a, Vec b) { return _mm_subs_epu8(a, b); }
+  static Vec SubsGap(Vec a, Vec b) { return Subs(a, b); }
+  static Vec Max(Vec a, Vec b) { return _mm_max_epu8(a, b); }
+  static Vec ShiftLeft(Vec v) { return _mm_slli_si128(v, 1); }
+  static bool AnyGreater(Vec a, Vec b) {
+    Vec d = _mm_subs_epu8(a, b);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(d, Zero())) != 0xffff;
+  }
+};
+
+//! \brief Saturating signed 16-bit lanes.
+//!
+//! Match scores are kept non negative, gap scores keep their exact value.
+struct StripedI16Ops {
+  using Vec = __m128i;
+  using Elem = int16_t;
+  static constexpr size_t Lanes = 8;
+  static constexpr ssize_t MaxValue = std::numeric_limits<int16_t>::max();
+
+  static Vec Load(const Elem *p) {
+    return _mm_loadu_si128(reinterpret_cast<const Vec *>(p));
+  }
+  static void Store(Elem *p, Vec v) {
+    _mm_storeu_si128(reinterpret_cast<Vec *>(p), v);
+  }
+  static Vec Set1(ssize_t x) { return _mm_set1_epi16(int16_t(x)); }
+  static Vec Zero() { return _mm_setzero_si128(); }
+  static Vec Min() {
+    return _mm_set1_epi16(std::numeric_limits<int16_t>::min());
+  }
+  static Vec Adds(Vec a, Vec b) { return _mm_adds_epi16(a, b); }
+  static Vec Subs(Vec a, Vec b) {
+    return _mm_max_epi16(_mm_subs_epi16(a, b), Zero());
+  }
+  static Vec SubsGap(Vec a, Vec b) { return _mm_subs_epi16(a, b); }
+  static Vec Max(Vec a, Vec b) { return _mm_max_epi16(a, b); }
+  static Vec ShiftLeft(Vec v) { return _mm_slli_si128(v, 2); }
+  static bool AnyGreater(Vec a, Vec b) {
+    return _mm_movemask_epi8(_mm_cmpgt_epi16(a, b)) != 0;
+  }
+  static Vec Greater(Vec a, Vec b) { return _mm_cmpgt_epi16(a, b); }
+  static Vec Equal(Vec a, Vec b) { return _mm_cmpeq_epi16(a, b); }
+  static Vec Or(Vec a, Vec b) { return _mm_or_si128(a, b); }
+  static Vec Select(Vec mask, Vec a, Vec b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+  }
+  //! Store the lanes, all in [0, 128), one byte each.
+  static void StoreBytes(uint8_t *p, Vec v) {
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(p), _mm_packus_epi16(v, v));
+  }
+};
+
+#define CPTS571_STRIPED_ALIGNMENT 1
+
+#endif
+
+//! \brief The query profile of the striped local alignment.
+//!
+//! For every row c of the ScoreProfile of the query, the score of aligning c
+//! to each character of the query laid out in the striped order of Farrar:
+//! the vector t holds the query positions t, t + L, t + 2L, ... where L is
+//! the length of a segment.
+class StripedQueryProfile {
+ public:
+  //! \brief Constructor
+  //! \param query The sequence whose profile is computed
+  //! \param S The score table
+  StripedQueryProfile(const Sequence & query, const ScoreTable & S)
+      : query_(query), S_(S), scores_(query, S)
+      , minScore_(scores_.MinScore()), maxScore_(scores_.MaxScore()) {
+#if defined(CPTS571_STRIPED_ALIGNMENT)
+    Build<StripedU8Ops>(profileU8_);
+    Build<StripedI16Ops>(profileI16_);
+#endif
+  }
+
+  const Sequence & Query() const { return query_; }
+
+  const ScoreTable & Scores() const { return S_; }
+
+  //! \brief The scores of the profile in the order of the query.
+  const ScoreProfile & Scalar() const { return scores_; }
+
+  //! \brief The row of the profile used for the character c.
+  size_t Index(char c) const { return scores_.Index(c); }
+
+  //! \brief The number of vectors of a segment.
+  template <typename Ops>
+  size_t SegmentLength() const {
+    return (query_.length() + Ops::Lanes - 1) / Ops::Lanes;
+  }
+
+  //! \brief The value added to the scores to make them non negative.
+  ssize_t Bias() const { return -minScore_; }
+
+  ssize_t MaxScore() const { return maxScore_; }
+
+  //! \brief Check if the scores fit the lanes of type Ops.
+  template <typename Ops>
+  bool Fits() const {
+    return minScore_ <= 0 && maxScore_ - minScore_ <= Ops::MaxValue &&
+           S_.H <= 0 && S_.G <= 0 && -(S_.H + S_.G) <= Ops::MaxValue;
+  }
+
+#if defined(CPTS571_STRIPED_ALIGNMENT)
+  const uint8_t * Profile(StripedU8Ops, size_t c) const {
+    return &profileU8_[c * SegmentLength<StripedU8Ops>() * StripedU8Ops::Lanes];
+  }
+
+  const int16_t * Profile(StripedI16Ops, size_t c) const {
+    return &profileI16_[c * SegmentLength<StripedI16Ops>() *
+                        StripedI16Ops::Lanes];
+  }
+#endif
+
+ private:
+  template <typename Ops>
+  void Build(std::vector<typename Ops::Elem> & profile) {
+    if (!Fits<Ops>()) return;
+
+    size_t segLen = SegmentLength<Ops>();
+    profile.assign(scores_.Symbols() * segLen * Ops::Lanes, 0);
+
+    for (size_t c = 0; c < scores_.Symbols(); ++c) {
+      auto row = &profile[c * segLen * Ops::Lanes];
+      auto scores = scores_.Row(scores_.Symbol(c));
+      for (size_t t = 0; t < segLen; ++t) {
+        for (size_t k = 0; k < Ops::Lanes; ++k) {
+          size_t j = k * segLen + t;
+          if (j >= query_.length()) continue;
+          row[t * Ops::Lanes + k] = scores[j] - minScore_;
+        }
+      }
+    }
+  }
+
+  const Sequence & query_;
+  ScoreTable S_;
+  ScoreProfile scores_;
+  ssize_t minScore_;
+  ssize_t maxScore_;
+  std::vector<uint8_t> profileU8_;
+  std::vector<int16_t> profileI16_;
+};
+
+#if defined(CPTS571_STRIPED_ALIGNMENT)
+
+//! \brief Farrar's striped local alignment on lanes of type Ops.
+//!
+//! The query is laid out along the lanes and the first rows of s1 are scanned
+//! one character per row.  After each row, visit(i, H, E, rowMax) receives the
+//! striped values of H(i,j) = max(M(i,j), I(i,j), D(i,j)) and of D(i + 1,j),
+//! and stops the scan returning false.
+template <typename Ops, typename Visitor>
+void StripedRows(const Sequence & s1, size_t rows,
+                 const StripedQueryProfile & P, Visitor && visit) {
+  using Vec = typename Ops::Vec;
+  using Elem = typename Ops::Elem;
+
+  const ScoreTable & S = P.Scores();
+  const size_t segLen = P.template SegmentLength<Ops>();
+  const size_t L = Ops::Lanes;
+
+  std::vector<Elem> HStore(segLen * L, 0);
+  std::vector<Elem> HLoad(segLen * L, 0);
+  std::vector<Elem> E(segLen * L);
+  for (size_t t = 0; t < segLen; ++t) Ops::Store(&E[t * L], Ops::Min());
+
+  const Vec vGapO = Ops::Set1(-(S.H + S.G));
+  const Vec vGapE = Ops::Set1(-S.G);
+  const Vec vBias = Ops::Set1(P.Bias());
+
+  for (size_t i = 0; i < rows; ++i) {
+    const Elem * profile = P.Profile(Ops(), P.Index(s1[i]));
+
+    Vec vF = Ops::Min();
+    Vec vMax = Ops::Zero();
+    Vec vH = Ops::ShiftLeft(Ops::Load(&HStore[(segLen - 1) * L]));
+    std::swap(HLoad, HStore);
+
+    for (size_t t = 0; t < segLen; ++t) {
+      vH = Ops::Subs(Ops::Adds(vH, Ops::Load(&profile[t * L])), vBias);
+      Vec vE = Ops::Load(&E[t * L]);
+      vH = Ops::Max(vH, vE);
+      vH = Ops::Max(vH, vF);
+      vMax = Ops::Max(vMax, vH);
+      Ops::Store(&HStore[t * L], vH);
+
+      vH = Ops::SubsGap(vH, vGapO);
+      vE = Ops::Max(Ops::SubsGap(vE, vGapE), vH);
+      Ops::Store(&E[t * L], vE);
+      vF = Ops::Max(Ops::SubsGap(vF, vGapE), vH);
+
+      vH = Ops::Load(&HLoad[t * L]);
+    }
+
+    // Lazy F loop: propagate the insertions across the segments.
+    vF = Ops::ShiftLeft(vF);
+    size_t t = 0;
+    while (Ops::AnyGreater(vF, Ops::Subs(Ops::Load(&HStore[t * L]), vGapO))) {
+      vH = Ops::Max(Ops::Load(&HStore[t * L]), vF);
+      Ops::Store(&HStore[t * L], vH);
+      Vec vE = Ops::Max(Ops::Load(&E[t * L]), Ops::SubsGap(vH, vGapO));
+      Ops::Store(&E[t * L], vE);
+      vF = Ops::SubsGap(vF, vGapE);
+      if (++t == segLen) {
+        t = 0;
+        vF = Ops::ShiftLeft(vF);
+      }
+    }
+
+    if (!visit(i + 1, HStore.data(), E.data(), vMax)) return;
+  }
+}
+
+//! \brief The best local alignment score on lanes of type Ops.
+//!
+//! \returns The first cell in row major order holding the best score, the
+//! score and a flag telling if the lanes overflowed.
+template <typename Ops>
+std::tuple<size_t, size_t, ssize_t, bool>
+StripedAlignmentScore(const Sequence & s1, const StripedQueryProfile & P) {
+  using Vec = typename Ops::Vec;
+  using Elem = typename Ops::Elem;
+
+  const size_t segLen = P.template SegmentLength<Ops>();
+  const size_t L = Ops::Lanes;
+  const ssize_t limit = Ops::MaxValue - P.Bias() - P.MaxScore();
+
+  std::tuple<size_t, size_t, ssize_t, bool> best(0, 0, 0, false);
+  Elem lanes[L];
+
+  StripedRows<Ops>(
+      s1, s1.length(), P,
+      [&](size_t i, const Elem * H, const Elem *, Vec vMax) {
+        Ops::Store(lanes, vMax);
+        ssize_t rowMax = *std::max_element(lanes, lanes + L);
+        if (rowMax > limit) {
+          std::get<3>(best) = true;
+          return false;
+        }
+
+        if (rowMax > std::get<2>(best)) {
+          // Cells raised by the lazy F loop are always below the row maximum.
+          size_t j = 0;
+          while (H[(j % segLen) * L + j / segLen] != rowMax) ++j;
+          best = std::make_tuple(i, j + 1, rowMax, false);
+        }
+        return true;
+      });
+
+  return best;
+}
+
+//! \brief The dynamic programming table of the local alignment rebuilt from
+//! the rows of the striped procedure.
+//!
+//! On signed 16-bit lanes the striped procedure keeps the exact values of
+//! H(i,j) and D(i,j).  M(i,j) follows from H(i - 1,j - 1) and the row of
+//! I(i,j) from the row of H(i,j), so that the traceback reads the same values
+//! of the table filled by the scalar procedure.
+class StripedTraceMatrix {
+ public:
+  using Ops = StripedI16Ops;
+  using CellTy = AffineCell;
+
+  //! \brief Constructor
+  //! \param s1 The first sequence
+  //! \param P  The query profile of the second sequence
+  //! \param rows The number of rows of the table
+  StripedTraceMatrix(const Sequence & s1, const StripedQueryProfile & P,
+                     size_t rows)
+      : s1_(s1), P_(P), rows_(rows), columns_(P.Query().length() + 1)
+      , segLen_(P.SegmentLength<Ops>())
+      , H_(rows * segLen_ * Ops::Lanes, 0)
+      , D_(rows * segLen_ * Ops::Lanes, 0)
+      , row_(0), filled_(0), I_(columns_) {
+    const size_t stride = segLen_ * Ops::Lanes;
+    StripedRows<Ops>(
+        s1, rows - 1, P,
+        [&](size_t i, const int16_t * H, const int16_t * E, Ops::Vec) {
+          std::copy(H, H + stride, &H_[i * stride]);
+          if (i + 1 < rows_) std::copy(E, E + stride, &D_[(i + 1) * stride]);
+          return true;
+        });
+  }
+
+  //! \brief Return the number of rows of the matrix
+  size_t rows() const { return rows_; }
+
+  //! \brief Return the number of columns of the matrix
+  size_t columns() const { return columns_; }
+
+  //! \brief Get the cell (i,j) of the matrix
+  CellTy operator()(size_t i, size_t j) const {
+    const ScoreTable & S = P_.Scores();
+    if (i == 0 || j == 0)
+      return AlignmentAlgorithmTrait<local_alignment_tag>::BoundaryCell(
+          S, i, j);
+
+    CellTy cell;
+    ssize_t score = P_.Scalar().Row(s1_[i - 1])[j - 1];
+    cell.Match = std::max(ssize_t(0), H(i - 1, j - 1) + score);
+    cell.Deletion = i == 1 ? S.H + S.G : Stored(D_, i, j);
+    cell.Insertion = Insertion(i, j);
+    return cell;
+  }
+
+ private:
+  ssize_t Stored(const std::vector<int16_t> & V, size_t i, size_t j) const {
+    size_t k = j - 1;
+    return V[(i * segLen_ + k % segLen_) * Ops::Lanes + k / segLen_];
+  }
+
+  ssize_t H(size_t i, size_t j) const {
+    return i == 0 || j == 0 ? 0 : Stored(H_, i, j);
+  }
+
+  //! \brief The insertion score of the cell (i,j).
+  //!
+  //! The scores of the row are computed left to right up to the column j and
+  //! kept for the following cells of the traceback.
+  ssize_t Insertion(size_t i, size_t j) const {
+    const ScoreTable & S = P_.Scores();
+    if (row_ != i) {
+      row_ = i;
+      filled_ = 1;
+      I_[1] = S.H + S.G;
+    }
+    for (; filled_ < j; ++filled_)
+      I_[filled_ + 1] =
+          std::max(H(i, filled_) + S.H + S.G, I_[filled_] + S.G);
+    return I_[j];
+  }
+
+  const Sequence & s1_;
+  const StripedQueryProfile & P_;
+  size_t rows_;
+  size_t columns_;
+  size_t segLen_;
+  std::vector<int16_t> H_;
+  std::vector<int16_t> D_;
+  mutable size_t row_;
+  mutable size_t filled_;
+  mutable std::vector<ssize_t> I_;
+};
+
+#endif
+
+//! \brief The striped local alignment score procedure.
+//!
+//! Run the striped procedure on 8-bit lanes and, if they overflow, again on
+//! 16-bit lanes.  When also those overflow fall back to the scalar procedure.
+//!
+//! \param s1 The first sequence
+//! \param P  The query profile of the second sequence
+//! \returns The cell (i,j) where the optimal alignment ends and its score.
+inline std::tuple<size_t, size_t, ssize_t>
+StripedAlignmentScore(const Sequence & s1, const StripedQueryProfile & P) {
+#if defined(CPTS571_STRIPED_ALIGNMENT)
+  size_t i, j;
+  ssize_t score;
+  bool overflow = true;
+
+  if (P.Fits<StripedU8Ops>())
+    std::tie(i, j, score, overflow) =
+        StripedAlignmentScore<StripedU8Ops>(s1, P);
+
+  if (overflow && P.Fits<StripedI16Ops>())
+    std::tie(i, j, score, overflow) =
+        StripedAlignmentScore<StripedI16Ops>(s1, P);
+
+  if (!overflow) return std::make_tuple(i, j, score);
+#endif
+
+  return AlignmentScore(s1, P.Query(), P.Scores(), local_alignment_tag());
+}
+
+//! \brief The striped local alignment procedure.
+//!
+//! The striped procedure finds the cell where the optimal alignment ends and
+//! rebuilds the rows of the table above it for the traceback.  Scores and
+//! actions are the same of Alignment(s1, s2, S, local_alignment_tag()).
+//!
+//! \param s1 The first sequence
+//! \param P  The query profile of the second sequence
+//! \returns The alignment of s1 and the query
+inline Cigar
+StripedAlignment(const Sequence & s1, const StripedQueryProfile & P) {
+  const Sequence & s2 = P.Query();
+  ScoreTable S = P.Scores();
+
+  size_t startI, startJ, endI, endJ;
+  ssize_t score;
+  std::tie(startI, startJ, score) = StripedAlignmentScore(s1, P);
+
+  // Without a positive score the alignment is left to the scalar procedure.
+  if (score == 0) return Alignment(s1, s2, S, local_alignment_tag());
+
+  // With a substitution matrix different characters may score positive.
+  Action action = s1[startI - 1] == s2[startJ - 1]
+      ? Action::Match : Action::Mismatch;
+
+  Cigar actionStack;
+#if defined(CPTS571_STRIPED_ALIGNMENT)
+  if (P.Fits<StripedI16Ops>() &&
+      score <= StripedI16Ops::MaxValue - P.Bias() - P.MaxScore()) {
+    StripedTraceMatrix M(s1, P, startI + 1);
+    std::tie(actionStack, endI, endJ) =
+        TraceBackActions<local_alignment_tag>(
+            M, startI, startJ, action, score, S, s1, s2);
+    actionStack.SetCoordinates(s1.length(), s2.length(),
+                               endI, endJ, startI, startJ);
+    return actionStack;
+  }
+#endif
+
+  // Fill the part of the table above and to the left of the last cell.
+  using AlgorithmTrait = AlignmentAlgorithmTrait<local_alignment_tag>;
+  typename AlgorithmTrait::MatrixTy M(startI + 1, startJ + 1);
+  AlgorithmTrait::InitializeMatrix(S, M);
+  for (size_t i = 1; i < M.rows(); ++i) {
+    const auto scores = P.Scalar().Row(s1[i-1]);
+    for (size_t j = 1; j < M.columns(); ++j) {
+      AlgorithmTrait::ComputeScore(S, M, i, j, scores[j-1]);
+    }
+  }
+
+  std::tie(actionStack, endI, endJ) =
+      TraceBackActions<local_alignment_tag>(
+          M, startI, startJ, action, score, S, s1, s2);
+  actionStack.SetCoordinates(s1.length(), s2.length(),
+                             endI, endJ, startI, startJ);
+
+  return actionStack;
+}
+
+}  // namespace cpts571
+
+#endif  // STRIPED_ALIGNMENT_H
@@ -0,0 +1,207 @@
+//===------------------------------------------------------------*- C++ -*-===//
+//
+// Copyright 2017 Marco Minutoli <mminutoli@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License. You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef SUBSTITUTION_MATRIX_H
+#define SUBSTITUTION_MATRIX_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cpts571 {
+
+//! \brief The score of aligning every pair of symbols of an alphabet.
+//!
+//! The scores are stored in a table indexed by the two characters, so that a
+//! lookup is a single load.  Pairs with a character outside the alphabet take
+//! the lowest score of the matrix.
+class SubstitutionMatrix {
+ public:
+  //! \brief Constructor
+  //! \param name The name of the matrix
+  //! \param alphabet The symbols of the matrix
+  //! \param scores The scores of the pairs of symbols, row by row
+  SubstitutionMatrix(const std::string & name, const std::string & alphabet,
+                     const std::vector<ssize_t> & scores)
+      : name_(name), alphabet_(alphabet), table_(256 * 256) {
+    if (alphabet.empty() || scores.size() != alphabet.size() * alphabet.size())
+      throw std::invalid_argument(
+          "The substitution matrix " + name + " is not a square table of "
+          "the size of its alphabet");
+    // The control characters are left to mark the masked bases of the reads.
+    for (char c : alphabet)
+      if (!std::isprint(static_cast<unsigned char>(c)))
+        throw std::invalid_argument(
+            "The alphabet of the substitution matrix " + name +
+            " has a character that is not printable");
+
+    minScore_ = *std::min_element(scores.begin(), scores.end());
+    maxScore_ = *std::max_element(scores.begin(), scores.end());
+
+    std::fill(table_.begin(), table_.end(), minScore_);
+    for (size_t a = 0; a < alphabet.size(); ++a)
+      for (size_t b = 0; b < alphabet.size(); ++b)
+        table_[Index(alphabet[a], alphabet[b])] =
+            scores[a * alphabet.size() + b];
+  }
+
+  //! \brief The score of aligning a to b.
+  ssize_t Score(char a, char b) const { return table_[Index(a, b)]; }
+
+  const std::string & Name() const { return name_; }
+
+  //! \brief The symbols with their own scores.
+  const std::string & Alphabet() const { return alphabet_; }
+
+  ssize_t MinScore() const { return minScore_; }
+  ssize_t MaxScore() const { return maxScore_; }
+
+  //! \brief The BLOSUM62 matrix of Henikoff and Henikoff.
+  static std::shared_ptr<const SubstitutionMatrix> Blosum62() {
+    // The rows and the columns follow the order of the alphabet.
+    static const char * rows[] = {
+      " 4 -1 -2 -2  0 -1 -1  0 -2 -1 -1 -1 -1 -2 -1  1  0 -3 -2  0 -2 -1  0 -4",
+      "-1  5  0 -2 -3  1  0 -2  0 -3 -2  2 -1 -3 -2 -1 -1 -3 -2 -3 -1  0 -1 -4",
+      "-2  0  6  1 -3  0  0  0  1 -3 -3  0 -2 -3 -2  1  0 -4 -2 -3  3  0 -1 -4",
+      "-2 -2  1  6 -3  0  2 -1 -1 -3 -4 -1 -3 -3 -1  0 -1 -4 -3 -3  4  1 -1 -4",
+      " 0 -3 -3 -3  9 -3 -4 -3 -3 -1 -1 -3 -1 -2 -3 -1 -1 -2 -2 -1 -3 -3 -2 -4",
+      "-1  1  0  0 -3  5  2 -2  0 -3 -2  1  0 -3 -1  0 -1 -2 -1 -2  0  3 -1 -4",
+      "-1  0  0  2 -4  2  5 -2  0 -3 -3  1 -2 -3 -1  0 -1 -3 -2 -2  1  4 -1 -4",
+      " 0 -2  0 -1 -3 -2 -2  6 -2 -4 -4 -2 -3 -3 -2  0 -2 -2 -3 -3 -1 -2 -1 -4",
+      "-2  0  1 -1 -3  0  0 -2  8 -3 -3 -1 -2 -1 -2 -1 -2 -2  2 -3  0  0 -1 -4",
+      "-1 -3 -3 -3 -1 -3 -3 -4 -3  4  2 -3  1  0 -3 -2 -1 -3 -1  3 -3 -3 -1 -4",
+      "-1 -2 -3 -4 -1 -2 -3 -4 -3  2  4 -2  2  0 -3 -2 -1 -2 -1  1 -4 -3 -1 -4",
+      "-1  2  0 -1 -3  1  1 -2 -1 -3 -2  5 -1 -3 -1  0 -1 -3 -2 -2  0  1 -1 -4",
+      "-1 -1 -2 -3 -1  0 -2 -3 -2  1  2 -1  5  0 -2 -1 -1 -1 -1  1 -3 -1 -1 -4",
+      "-2 -3 -3 -3 -2 -3 -3 -3 -1  0  0 -3  0  6 -4 -2 -2  1  3 -1 -3 -3 -1 -4",
+      "-1 -2 -2 -1 -3 -1 -1 -2 -2 -3 -3 -1 -2 -4  7 -1 -1 -4 -3 -2 -2 -1 -2 -4",
+      " 1 -1  1  0 -1  0  0  0 -1 -2 -2  0 -1 -2 -1  4  1 -3 -2 -2  0  0  0 -4",
+      " 0 -1  0 -1 -1 -1 -1 -2 -2 -1 -1 -1 -1 -2 -1  1  5 -2 -2  0 -1 -1  0 -4",
+      "-3 -3 -4 -4 -2 -2 -3 -2 -2 -3 -2 -3 -1  1 -4 -3 -2 11  2 -3 -4 -3 -2 -4",
+      "-2 -2 -2 -3 -2 -1 -2 -3  2 -1 -1 -2 -1  3 -3 -2 -2  2  7 -1 -3 -2 -1 -4",
+      " 0 -3 -3 -3 -1 -2 -2 -3 -3  3  1 -2  1 -1 -2 -2  0 -3 -1  4 -3 -2 -1 -4",
+      "-2 -1  3  4 -3  0  1 -1  0 -3 -4  0 -3 -3 -2  0 -1 -4 -3 -3  4  1 -1 -4",
+      "-1  0  0  1 -3  3  4 -2  0 -3 -3  1 -1 -3 -1  0 -1 -3 -2 -2  1  4 -1 -4",
+      " 0 -1 -1 -1 -2 -1 -1 -1 -1 -1 -1 -1 -1 -1 -2  0  0 -2 -1 -1 -1 -1 -1 -4",
+      "-4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4  1",
+    };
+    static const std::string alphabet = "ARNDCQEGHILKMFPSTWYVBZX*";
+
+    static const auto matrix = []() {
+      std::vector<ssize_t> scores;
+      for (auto row : rows) {
+        std::istringstream is(row);
+        for (ssize_t score; is >> score;) scores.push_back(score);
+      }
+      return std::make_shared<const SubstitutionMatrix>(
+          "BLOSUM62", alphabet, scores);
+    }();
+    return matrix;
+  }
+
+  //! \brief The nucleotide matrix of the IUPAC ambiguity codes.
+  //!
+  //! Two codes score match when they may stand for the same base and
+  //! mismatch otherwise.
+  static std::shared_ptr<const SubstitutionMatrix>
+  Iupac(ssize_t match, ssize_t mismatch) {
+    // The bases (A = 1, C = 2, G = 4, T = 8) each code stands for.
+    static const std::string alphabet = "ACGTURYSWKMBDHVN";
+    static const uint8_t bases[] = {
+      1, 2, 4, 8, 8, 5, 10, 6, 9, 12, 3, 14, 13, 11, 7, 15
+    };
+
+    std::vector<ssize_t> scores;
+    for (size_t a = 0; a < alphabet.size(); ++a)
+      for (size_t b = 0; b < alphabet.size(); ++b)
+        scores.push_back((bases[a] & bases[b]) != 0 ? match : mismatch);
+
+    return std::make_shared<const SubstitutionMatrix>(
+        "IUPAC", alphabet, scores);
+  }
+
+ private:
+  static size_t Index(char a, char b) {
+    return size_t(uint8_t(a)) << 8 | uint8_t(b);
+  }
+
+  std::string name_;
+  std::string alphabet_;
+  std::vector<int32_t> table_;
+  ssize_t minScore_;
+  ssize_t maxScore_;
+};
+
+//! \brief Read the substitution matrix of a JSON configuration.
+//!
+//! The matrix is either the name of a predefined matrix (BLOSUM62, or IUPAC
+//! scoring the configured match and mismatch) or an object listing its
+//! "alphabet" and the rows of its "scores".
+//!
+//! \param value The JSON value describing the matrix
+//! \param match The match score of the configuration
+//! \param mismatch The mismatch score of the configuration
+template <typename JSONValue>
+std::shared_ptr<const SubstitutionMatrix>
+ParseSubstitutionMatrix(const JSONValue & value,
+                        ssize_t match, ssize_t mismatch) {
+  if (value.IsString()) {
+    std::string name(value.GetString(), value.GetStringLength());
+    if (name == "BLOSUM62") return SubstitutionMatrix::Blosum62();
+    if (name == "IUPAC") return SubstitutionMatrix::Iupac(match, mismatch);
+    throw std::invalid_argument("Unknown substitution matrix " + name);
+  }
+
+  if (!value.IsObject() || !value.HasMember("alphabet") ||
+      !value.HasMember("scores") || !value["alphabet"].IsString() ||
+      !value["scores"].IsArray())
+    throw std::invalid_argument(
+        "A substitution matrix needs an alphabet and its scores");
+
+  std::string alphabet(value["alphabet"].GetString(),
+                       value["alphabet"].GetStringLength());
+  std::string name = "custom";
+  if (value.HasMember("name") && value["name"].IsString())
+    name = value["name"].GetString();
+
+  std::vector<ssize_t> scores;
+  const auto & rows = value["scores"];
+  for (decltype(rows.Size()) i = 0; i < rows.Size(); ++i) {
+    if (!rows[i].IsArray() || rows[i].Size() != alphabet.size())
+      throw std::invalid_argument(
+          "Every row of the substitution matrix needs a score per symbol");
+    for (decltype(rows.Size()) j = 0; j < rows[i].Size(); ++j) {
+      if (!rows[i][j].IsInt64())
+        throw std::invalid_argument(
+            "The substitution scores must be integers");
+      scores.push_back(rows[i][j].GetInt64());
+    }
+  }
+
+  return std::make_shared<const SubstitutionMatrix>(name, alphabet, scores);
+}
+
+}  // namespace cpts571
+
+#endif  // SUBSTITUTION_MATRIX_H
@@ -88,6 +88,11 @@ class SuffixTreeNode {
   typename children_map::mapped_type &
   operator[](const typename children_map::key_type &i) { return children_[i]; }
 
+  node_ptr Child(const typename children_map::key_type &i) const {
+    auto itr = children_.find(i);
+    return itr != children_.end() ? itr->second : nullptr;
+  }
+
   typename std::string::const_iterator
   BeginIncomingArcString() const { return arcStringStart_; }
   typename std::string::const_iterator
@@ -331,6 +336,13 @@ class SuffixTree {
 
   std::vector<size_t> FindLoc(const Sequence & read) const;
 
+  //! \brief Find the longest substring of read (of length at least x)
+  //! occurring in the sequence.
+  //! \returns The positions of the substring in the sequence, its offset in
+  //! the read and its length.
+  std::tuple<std::vector<size_t>, size_t, size_t>
+  FindSeed(const Sequence & read) const;
+
  private:
   std::tuple<node_ptr, Sequence::const_iterator>
   FindLoc(node_ptr r, Sequence::const_iterator i, Sequence::const_iterator E) const;
@@ -0,0 +1,181 @@
+//===------------------------------------------------------------*- C++ -*-===//
+//
+// Copyright 2017 Marco Minutoli <mminutoli@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License. You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cpts571 {
+
+//! \brief A fixed set of threads running parallel loops.
+//!
+//! The thread calling ParallelFor or StealingFor takes part in the loop, so a
+//! pool of size n starts n - 1 worker threads.
+class ThreadPool {
+ public:
+  //! \brief Constructor
+  //! \param threads The number of threads running the parallel loops
+  explicit ThreadPool(size_t threads)
+      : workers_(), mutex_(), wakeUp_(), done_()
+      , job_(), next_(0), running_(0), generation_(0)
+      , stop_(false) {
+    for (size_t i = 1; i < threads; ++i)
+      workers_.emplace_back([this, i]() { Worker(i); });
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wakeUp_.notify_all();
+    for (auto & w : workers_) w.join();
+  }
+
+  //! \brief Return the number of threads of the pool
+  size_t size() const { return workers_.size() + 1; }
+
+  //! \brief Run f(k) for every k in [0, n) and wait for all of them.
+  template <typename F>
+  void ParallelFor(size_t n, F && f) {
+    if (workers_.empty() || n <= 1) {
+      for (size_t k = 0; k < n; ++k) f(k);
+      return;
+    }
+
+    next_ = 0;
+    Run([&](size_t) {
+        for (size_t k = next_++; k < n; k = next_++) f(k);
+      });
+  }
+
+  //! \brief Run f(k) for every k in [0, n) with work stealing and wait for all
+  //! of them.
+  //!
+  //! Thread t owns the iterations t, t + size(), t + 2 size(), ... and runs
+  //! them in increasing order.  A thread without iterations left steals the
+  //! last one of another thread.  Listing the iterations from the longest to
+  //! the shortest keeps all the threads busy until the end of the loop: every
+  //! thread starts from a long one and the stolen ones are the shortest.
+  template <typename F>
+  void StealingFor(size_t n, F && f) {
+    if (workers_.empty() || n <= 1) {
+      for (size_t k = 0; k < n; ++k) f(k);
+      return;
+    }
+
+    std::vector<Queue> queues(size());
+    for (size_t t = 0; t < queues.size(); ++t)
+      queues[t].end = (n + queues.size() - 1 - t) / queues.size();
+
+    Run([&](size_t t) {
+        const size_t threads = queues.size();
+        for (size_t position; queues[t].PopFront(position);)
+          f(t + position * threads);
+
+        for (size_t victim = (t + 1) % threads; victim != t;) {
+          size_t position;
+          if (queues[victim].PopBack(position))
+            f(victim + position * threads);
+          else
+            victim = (victim + 1) % threads;
+        }
+      });
+  }
+
+ private:
+  //! \brief The positions [begin, end) of the iterations left to a thread.
+  struct Queue {
+    Queue() : mutex(), begin(0), end(0) {}
+
+    bool PopFront(size_t & position) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (begin == end) return false;
+      position = begin++;
+      return true;
+    }
+
+    bool PopBack(size_t & position) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (begin == end) return false;
+      position = --end;
+      return true;
+    }
+
+    std::mutex mutex;
+    size_t begin;
+    size_t end;
+  };
+
+  //! \brief Run job(t) on every thread t of the pool and wait for all of them.
+  void Run(std::function<void(size_t)> job) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_ = std::move(job);
+      running_ = workers_.size();
+      ++generation_;
+    }
+    wakeUp_.notify_all();
+
+    job_(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return running_ == 0; });
+    job_ = nullptr;
+  }
+
+  void Worker(size_t thread) {
+    size_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      wakeUp_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+      if (stop_) return;
+      seen = generation_;
+
+      lock.unlock();
+      job_(thread);
+      lock.lock();
+
+      if (--running_ == 0) done_.notify_all();
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable wakeUp_;
+  std::condition_variable done_;
+  std::function<void(size_t)> job_;
+  std::atomic<size_t> next_;
+  size_t running_;
+  size_t generation_;
+  bool stop_;
+};
+
+}  // namespace cpts571
+
+#endif  // THREAD_POOL_H
@@ -0,0 +1,357 @@
+//===------------------------------------------------------------*- C++ -*-===//
+//
+// Copyright 2017 Marco Minutoli <mminutoli@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License. You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef WFA_ALIGNMENT_H
+#define WFA_ALIGNMENT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "cpts571/Alignment.h"
+#include "cpts571/Sequence.h"
+
+namespace cpts571 {
+
+struct wfa_global_alignment_tag {};
+
+//! \brief The penalties of the wavefront alignment equivalent to a score table.
+//!
+//! Every column of a global alignment of s1 and s2 consumes two characters
+//! when it aligns them and one when it is a gap, so the score of the table is
+//! 2 * score = Match * (|s1| + |s2|) - penalty, where matches are free,
+//! mismatches cost 2 (Match - Mismatch), the opening of a gap -2 H and each
+//! character of a gap Match - 2 G.
+struct WFAPenalties {
+  explicit WFAPenalties(const ScoreTable & S)
+      : Mismatch(2 * (S.Match - S.Mismatch))
+      , GapOpen(-2 * S.H)
+      , GapExtend(S.Match - 2 * S.G) {}
+
+  //! \brief Check if the wavefronts can be computed with these penalties.
+  bool Valid() const {
+    return Mismatch > 0 && GapOpen >= 0 && GapExtend > 0;
+  }
+
+  ssize_t Mismatch;
+  ssize_t GapOpen;
+  ssize_t GapExtend;
+};
+
+//! \brief Global alignment with affine gaps by wavefronts.
+//!
+//! The gap-affine wavefront algorithm of Marco-Sola et al. ("Fast gap-affine
+//! pairwise alignment using the wavefront algorithm", 2020).  The wavefront
+//! of a penalty s stores, for every diagonal k = j - i, the furthest column
+//! reached with penalty s in each of the three states.  The wavefront of s
+//! follows from the ones of s - Mismatch, s - GapExtend and s - GapOpen -
+//! GapExtend, and its match offsets are then extended along the diagonals as
+//! far as the characters are equal.  The first wavefront reaching the cell
+//! (|s1|,|s2|) gives the optimal penalty, so the procedure runs in time
+//! O((|s1| + |s2|) s) and is fast on similar sequences.  The backtrace needs
+//! all the wavefronts, O(s^2) offsets, while the score alone only needs the
+//! ones a new wavefront is computed from.
+class WFAAligner {
+ public:
+  //! \brief Constructor
+  //! \param s1 The first sequence
+  //! \param s2 The second sequence
+  //! \param S  The score table, with Valid() WFAPenalties
+  WFAAligner(const Sequence &s1, const Sequence &s2, const ScoreTable &S)
+      : s1_(s1), s2_(s2), P_(S), match_(S.Match)
+      , m_(s1.length()), n_(s2.length())
+      , wavefronts_(), memory_(0)
+  {}
+
+  //! \brief Check if the wavefronts can align with the score table.
+  static bool Supports(const ScoreTable & S) {
+    return !S.Substitution && WFAPenalties(S).Valid();
+  }
+
+  //! \brief Run the alignment procedure.
+  //! \param memoryBudget The bytes the wavefronts may take
+  //! \param[out] cigar The alignment of s1 and s2
+  //! \returns false when the wavefronts exceed the memory budget.
+  bool Align(size_t memoryBudget, Cigar & cigar) {
+    ssize_t s;
+    if (!Run(memoryBudget, true, s)) return false;
+
+    cigar = Backtrace(s);
+    cigar.SetCoordinates(s1_.length(), s2_.length(), 0, 0, m_, n_);
+    return true;
+  }
+
+  //! \brief Compute only the optimal score.
+  //! \param memoryBudget The bytes the wavefronts may take
+  //! \param[out] score The score of the optimal alignment of s1 and s2
+  //! \returns false when the wavefronts exceed the memory budget.
+  bool Score(size_t memoryBudget, ssize_t & score) {
+    ssize_t s;
+    if (!Run(memoryBudget, false, s)) return false;
+
+    score = (match_ * ssize_t(m_ + n_) - s) / 2;
+    return true;
+  }
+
+ private:
+  using Offset = int32_t;
+
+  //! \brief The offset of the diagonals not reached.
+  enum : Offset { None = std::numeric_limits<Offset>::min() / 2 };
+
+  //! \brief The offsets of the diagonals [lo, hi] of the three states.
+  struct Wavefront {
+    Wavefront() : lo(1), hi(0) {}
+
+    Wavefront(ssize_t l, ssize_t h)
+        : lo(l), hi(h)
+        , M(h - l + 1, None), I(h - l + 1, None), D(h - l + 1, None) {}
+
+    bool Empty() const { return lo > hi; }
+
+    ssize_t lo;
+    ssize_t hi;
+    std::vector<Offset> M;
+    std::vector<Offset> I;
+    std::vector<Offset> D;
+  };
+
+  //! \brief The offset of the state V on the diagonal k with penalty s.
+  Offset Get(ssize_t s, std::vector<Offset> Wavefront::*V, ssize_t k) const {
+    if (s < 0) return None;
+    const Wavefront & W = wavefronts_[s];
+    if (k < W.lo || k > W.hi) return None;
+    return (W.*V)[k - W.lo];
+  }
+
+  //! \brief The offset moved by step columns, if still inside the table.
+  Offset Clip(Offset offset, Offset step, ssize_t k) const {
+    if (offset == None) return None;
+    offset += step;
+    if (offset > ssize_t(n_) || offset - k > ssize_t(m_)) return None;
+    return offset;
+  }
+
+  //! \brief The match offset of the diagonal k, reached with a mismatch.
+  Offset FromMismatch(ssize_t s, ssize_t k) const {
+    return Clip(Get(s - P_.Mismatch, &Wavefront::M, k), 1, k);
+  }
+
+  //! \brief The bytes of the wavefront W.
+  static size_t Size(const Wavefront & W) {
+    return sizeof(Wavefront) + (W.M.size() + W.I.size() + W.D.size()) *
+        sizeof(Offset);
+  }
+
+  //! \brief Compute the wavefronts up to the one reaching (|s1|,|s2|).
+  //!
+  //! Without the backtrace only the last GapOpen + GapExtend (or Mismatch,
+  //! when larger) wavefronts are kept.
+  //!
+  //! \param memoryBudget The bytes the wavefronts may take
+  //! \param keep Keep all the wavefronts for the backtrace
+  //! \param[out] s The optimal penalty
+  //! \returns false when the wavefronts exceed the memory budget.
+  bool Run(size_t memoryBudget, bool keep, ssize_t & s) {
+    const ssize_t window = std::max(P_.GapOpen + P_.GapExtend, P_.Mismatch);
+    wavefronts_.clear();
+    memory_ = 0;
+
+    Wavefront first(0, 0);
+    first.M[0] = 0;
+    Extend(first);
+    memory_ += Size(first);
+    wavefronts_.push_back(std::move(first));
+
+    s = 0;
+    while (!Reached(wavefronts_[s])) {
+      ++s;
+      wavefronts_.push_back(Next(s));
+      memory_ += Size(wavefronts_[s]);
+
+      if (!keep && s > window) {
+        memory_ -= Size(wavefronts_[s - window - 1]) - sizeof(Wavefront);
+        wavefronts_[s - window - 1] = Wavefront();
+      }
+      if (memory_ > memoryBudget) return false;
+    }
+    return true;
+  }
+
+  bool Reached(const Wavefront & W) const {
+    ssize_t k = ssize_t(n_) - ssize_t(m_);
+    return k >= W.lo && k <= W.hi && W.M[k - W.lo] == Offset(n_);
+  }
+
+  //! \brief Follow the diagonals of the match offsets over equal characters.
+  void Extend(Wavefront & W) const {
+    const char * a = m_ ? &*s1_.begin() : nullptr;
+    const char * b = n_ ? &*s2_.begin() : nullptr;
+    for (ssize_t k = W.lo; k <= W.hi; ++k) {
+      Offset & offset = W.M[k - W.lo];
+      // Diagonals not reached, or past the end of the table.
+      if (offset == None) continue;
+
+      size_t j = offset, i = offset - k;
+      for (uint64_t x, y; i + 8 <= m_ && j + 8 <= n_; i += 8, j += 8) {
+        std::memcpy(&x, a + i, 8);
+        std::memcpy(&y, b + j, 8);
+        if (x != y) break;
+      }
+      while (i < m_ && j < n_ && a[i] == b[j]) {
+        ++i;
+        ++j;
+      }
+      offset = j;
+    }
+  }
+
+  //! \brief The wavefront of the penalty s.
+  Wavefront Next(ssize_t s) const {
+    const ssize_t open = s - P_.GapOpen - P_.GapExtend;
+    const ssize_t extend = s - P_.GapExtend;
+    const ssize_t mismatch = s - P_.Mismatch;
+
+    ssize_t lo = std::numeric_limits<ssize_t>::max();
+    ssize_t hi = std::numeric_limits<ssize_t>::min();
+    for (ssize_t source : { open, extend, mismatch }) {
+      if (source < 0 || wavefronts_[source].Empty()) continue;
+      lo = std::min(lo, wavefronts_[source].lo - 1);
+      hi = std::max(hi, wavefronts_[source].hi + 1);
+    }
+    lo = std::max(lo, -ssize_t(m_));
+    hi = std::min(hi, ssize_t(n_));
+    if (lo > hi) return Wavefront();
+
+    Wavefront W(lo, hi);
+    bool reached = false;
+    for (ssize_t k = lo; k <= hi; ++k) {
+      Offset insertion = Clip(std::max(Get(open, &Wavefront::M, k - 1),
+                                       Get(extend, &Wavefront::I, k - 1)),
+                              1, k);
+      Offset deletion = Clip(std::max(Get(open, &Wavefront::M, k + 1),
+                                      Get(extend, &Wavefront::D, k + 1)),
+                             0, k);
+      Offset match = std::max({ FromMismatch(s, k), insertion, deletion });
+
+      W.I[k - lo] = insertion;
+      W.D[k - lo] = deletion;
+      W.M[k - lo] = match;
+      reached = reached || match != None;
+    }
+    if (!reached) return Wavefront();
+
+    Extend(W);
+    return W;
+  }
+
+  //! \brief Follow the wavefronts back from the cell (|s1|,|s2|) reached with
+  //! penalty s.
+  Cigar Backtrace(ssize_t s) const {
+    enum class State { Match, Insertion, Deletion };
+
+    Cigar cigar;
+    State state = State::Match;
+    ssize_t k = ssize_t(n_) - ssize_t(m_);
+    Offset offset = n_;
+
+    for (;;) {
+      if (state == State::Match) {
+        Offset mismatch = FromMismatch(s, k);
+        Offset insertion = Get(s, &Wavefront::I, k);
+        Offset deletion = Get(s, &Wavefront::D, k);
+        Offset base = s == 0 ? 0 : std::max({ mismatch, insertion, deletion });
+
+        cigar.push_back(Action::Match, offset - base);
+        offset = base;
+        if (s == 0) break;
+
+        if (base == mismatch) {
+          size_t j = offset - 1, i = j - k;
+          cigar.push_back(
+              s1_[i] == s2_[j] ? Action::Match : Action::Mismatch);
+          s -= P_.Mismatch;
+          --offset;
+        } else if (base == insertion) {
+          state = State::Insertion;
+        } else {
+          state = State::Deletion;
+        }
+      } else if (state == State::Insertion) {
+        cigar.push_back(Action::Insertion);
+        Offset opened = Clip(Get(s - P_.GapOpen - P_.GapExtend,
+                                 &Wavefront::M, k - 1), 1, k);
+        if (opened == offset) {
+          state = State::Match;
+          s -= P_.GapOpen;
+        }
+        s -= P_.GapExtend;
+        --k;
+        --offset;
+      } else {
+        cigar.push_back(Action::Deletion);
+        Offset opened = Clip(Get(s - P_.GapOpen - P_.GapExtend,
+                                 &Wavefront::M, k + 1), 0, k);
+        if (opened == offset) {
+          state = State::Match;
+          s -= P_.GapOpen;
+        }
+        s -= P_.GapExtend;
+        ++k;
+      }
+    }
+
+    return cigar;
+  }
+
+  const Sequence &s1_;
+  const Sequence &s2_;
+  WFAPenalties P_;
+  ssize_t match_;
+  size_t m_;
+  size_t n_;
+  std::vector<Wavefront> wavefronts_;
+  size_t memory_;
+};
+
+//! \brief The wavefront global alignment procedure.
+//!
+//! The alignment has the optimal score of Alignment(s1, s2, S,
+//! global_alignment_tag()).  Score tables without an equivalent set of
+//! WFAPenalties, and substitution matrices, fall back to that procedure.
+//!
+//! \param s1 The first sequence
+//! \param s2 The second sequence
+//! \param S  The score table
+//! \returns The alignment of s1 and s2
+inline Cigar
+Alignment(const Sequence &s1, const Sequence &s2,
+          ScoreTable &S, const wfa_global_alignment_tag &) {
+  Cigar cigar;
+  if (WFAAligner::Supports(S) &&
+      WFAAligner(s1, s2, S).Align(std::numeric_limits<size_t>::max(), cigar))
+    return cigar;
+  return Alignment(s1, s2, S, global_alignment_tag());
+}
+
+}  // namespace cpts571
+
+#endif  // WFA_ALIGNMENT_H
@@ -0,0 +1,151 @@
+//===------------------------------------------------------------*- C++ -*-===//
+//
+// Copyright 2017 Marco Minutoli <mminutoli@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License. You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef WAVEFRONT_ALIGNMENT_H
+#define WAVEFRONT_ALIGNMENT_H
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+#include "cpts571/Alignment.h"
+#include "cpts571/Sequence.h"
+#include "cpts571/ThreadPool.h"
+
+namespace cpts571 {
+
+//! \brief Fill the table in tiles along its anti-diagonals.
+//!
+//! The tile (bi,bj) needs only the tiles above and to its left, so the tiles
+//! of an anti-diagonal bi + bj = d are independent and filled in parallel.
+//! Each tile keeps the best score of its cells and the results are reduced
+//! picking the first cell in row major order, as the sequential fill does.
+template <typename algorithm_tag, typename Score, typename Layout,
+          typename MatrixT>
+std::tuple<size_t, size_t, ssize_t>
+FillMatrixWavefront(const Sequence &s1, const Sequence &s2,
+                    const ScoreTable &S, const MatrixT & M,
+                    ThreadPool & pool, size_t tileSize) {
+  using AlgorithmTrait = AlignmentAlgorithmTrait<algorithm_tag, Score, Layout>;
+
+  const size_t rows = M.rows() - 1;
+  const size_t columns = M.columns() - 1;
+  const size_t tileRows = (rows + tileSize - 1) / tileSize;
+  const size_t tileColumns = (columns + tileSize - 1) / tileSize;
+
+  if (tileRows == 0 || tileColumns == 0) return std::make_tuple(0, 0, 0);
+
+  std::vector<std::tuple<size_t, size_t, ssize_t>> bests(
+      tileRows * tileColumns, std::make_tuple(0, 0, 0));
+  ScoreProfile P(s2, S);
+
+  for (size_t d = 0; d + 1 < tileRows + tileColumns; ++d) {
+    size_t firstTile = d < tileColumns ? 0 : d - tileColumns + 1;
+    size_t lastTile = std::min(d, tileRows - 1);
+
+    pool.ParallelFor(lastTile - firstTile + 1, [&](size_t k) {
+        size_t bi = firstTile + k;
+        size_t bj = d - bi;
+        auto & best = bests[bi * tileColumns + bj];
+
+        size_t lastI = std::min(rows, (bi + 1) * tileSize);
+        size_t lastJ = std::min(columns, (bj + 1) * tileSize);
+        for (size_t i = bi * tileSize + 1; i <= lastI; ++i) {
+          const auto scores = P.Row(s1[i-1]);
+          for (size_t j = bj * tileSize + 1; j <= lastJ; ++j) {
+            AlgorithmTrait::ComputeScore(S, M, i, j, scores[j-1]);
+            AlgorithmTrait::UpdateBestScore(M, i, j, best);
+          }
+        }
+      });
+  }
+
+  std::tuple<size_t, size_t, ssize_t> best(0, 0, 0);
+  for (auto & b : bests) {
+    if (std::get<2>(b) > std::get<2>(best) ||
+        (std::get<2>(b) == std::get<2>(best) && b < best))
+      best = b;
+  }
+
+  return best;
+}
+
+//! \brief The parallel alignment procedure on a table of the given score type
+//! and layout.
+template <typename algorithm_tag, typename Score, typename Layout>
+Cigar
+BasicWavefrontAlignment(const Sequence &s1, const Sequence &s2,
+                        const ScoreTable &S, ThreadPool & pool,
+                        size_t tileSize) {
+  using AlgorithmTrait = AlignmentAlgorithmTrait<algorithm_tag, Score, Layout>;
+  using Matrix = typename AlgorithmTrait::MatrixTy;
+
+  Matrix M(s1.length() + 1, s2.length() + 1);
+  AlgorithmTrait::InitializeMatrix(S, M);
+
+  std::tuple<size_t, size_t, ssize_t> best =
+      FillMatrixWavefront<algorithm_tag, Score, Layout>(
+          s1, s2, S, M, pool, tileSize);
+
+  size_t startI, startJ, endI, endJ;
+  ssize_t score;
+  Action action;
+  std::tie(startI, startJ, score, action) =
+      AlgorithmTrait::GetFinalScoreAndAction(M, s1, s2, best);
+
+  Cigar actionStack;
+
+  std::tie(actionStack, endI, endJ) =
+      TraceBackActions<algorithm_tag>(
+          M, startI, startJ, action, score, S, s1, s2);
+
+  actionStack.SetCoordinates(s1.length(), s2.length(),
+                             endI, endJ, startI, startJ);
+
+  return actionStack;
+}
+
+//! \brief The parallel alignment procedure.
+//!
+//! Same as Alignment(s1, s2, S, algorithm_tag()) with the table filled by the
+//! threads of pool in square tiles of tileSize cells per side.
+//!
+//! \param s1 The first sequence
+//! \param s2 The second sequence
+//! \param S  The score table
+//! \param pool The threads filling the table
+//! \param tileSize The side of the tiles
+//! \returns The alignment of s1 and s2
+template <typename algorithm_tag>
+Cigar
+WavefrontAlignment(const Sequence &s1, const Sequence &s2,
+                   const ScoreTable &S, const algorithm_tag &,
+                   ThreadPool & pool, size_t tileSize = 128) {
+  return DispatchScoreType(
+      s1.length() + 1, s2.length() + 1, S,
+      [&](auto score) {
+        return BasicWavefrontAlignment<algorithm_tag, decltype(score),
+                                       struct_of_arrays_tag>(
+            s1, s2, S, pool, tileSize);
+      });
+}
+
+}  // namespace cpts571
+
+#endif  // WAVEFRONT_ALIGNMENT_H
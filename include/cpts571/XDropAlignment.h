@@ -0,0 +1,221 @@
+//===------------------------------------------------------------*- C++ -*-===//
+//
+// Copyright 2017 Marco Minutoli <mminutoli@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not
+// use this file except in compliance with the License. You may obtain a copy
+// of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+//
+//===----------------------------------------------------------------------===//
+
+
+#ifndef XDROP_ALIGNMENT_H
+#define XDROP_ALIGNMENT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <tuple>
+#include <vector>
+
+#include "cpts571/Alignment.h"
+#include "cpts571/CompactAlignment.h"
+#include "cpts571/Sequence.h"
+
+namespace cpts571 {
+
+//! \brief Gapped X-drop extension of an alignment anchored before a and b.
+//!
+//! The table is filled row by row, keeping only the cells whose score is
+//! within X of the best match score seen so far.  A row is filled to the
+//! right until its cells can no longer reach the previous row, and the
+//! extension stops at the first row without cells left.  Only the traceback
+//! directions of the filled cells are stored.
+//!
+//! \param a The first sequence, running away from the anchor
+//! \param m The length of the first sequence
+//! \param b The second sequence, running away from the anchor
+//! \param n The length of the second sequence
+//! \param S The score table
+//! \param X The drop from the best score that ends the extension
+//! \returns The alignment from the best cell back to the anchor, the row and
+//! the column of the best cell and its score.
+template <typename Iterator>
+std::tuple<Cigar, size_t, size_t, ssize_t>
+XDropExtend(Iterator a, size_t m, Iterator b, size_t n,
+            const ScoreTable &S, ssize_t X) {
+  using State = DirectionMatrix::State;
+
+  const ssize_t inf = ScoreTraits<ssize_t>::NegativeInfinity();
+  const AffineCell dropped{inf, inf, inf};
+  const ssize_t open = S.H + S.G;
+  const ScoreProfile P(b, b + n, S);
+
+  struct Row {
+    size_t first;
+    std::vector<uint8_t> directions;
+  };
+  std::vector<Row> rows;
+
+  std::vector<AffineCell> previous;
+  std::vector<AffineCell> current;
+  size_t previousFirst = 0;
+
+  size_t bestI = 0, bestJ = 0;
+  ssize_t best = 0;
+
+  for (size_t i = 0; i <= m; ++i) {
+    const size_t first = previousFirst;
+    const size_t previousEnd = previousFirst + previous.size();
+    auto above = [&](size_t j) {
+      return i > 0 && j >= previousFirst && j < previousEnd
+          ? previous[j - previousFirst] : dropped;
+    };
+
+    rows.push_back(Row{first, {}});
+    auto & directions = rows.back().directions;
+    current.clear();
+    const auto scores = P.Row(i > 0 ? a[i - 1] : '\0');
+
+    for (size_t j = first; j <= n; ++j) {
+      const AffineCell diagonal = j > 0 ? above(j - 1) : dropped;
+      const AffineCell up = above(j);
+      const AffineCell left = j > first ? current.back() : dropped;
+
+      AffineCell cell = dropped;
+      if (i == 0 && j == 0) {
+        cell.Match = 0;
+      } else {
+        if (i > 0 && j > 0)
+          cell.Match = std::max(
+              inf,
+              std::max({diagonal.Match, diagonal.Insertion, diagonal.Deletion})
+              + scores[j - 1]);
+        cell.Insertion = std::max({
+            inf, left.Match + open, left.Insertion + S.G,
+            left.Deletion + open});
+        cell.Deletion = std::max({
+            inf, up.Match + open, up.Insertion + open, up.Deletion + S.G});
+      }
+
+      directions.push_back(
+          DirectionMatrix::Argmax(
+              diagonal.Match, diagonal.Insertion, diagonal.Deletion) |
+          DirectionMatrix::Argmax(
+              left.Match + open, left.Insertion + S.G,
+              left.Deletion + open) << 2 |
+          DirectionMatrix::Argmax(
+              up.Match + open, up.Insertion + open, up.Deletion + S.G) << 4);
+
+      if (cell.Match > best) {
+        best = cell.Match;
+        bestI = i;
+        bestJ = j;
+      }
+
+      bool drop = std::max({cell.Match, cell.Insertion, cell.Deletion})
+                  < best - X;
+      current.push_back(drop ? dropped : cell);
+
+      // Past the end of the previous row only the left cell feeds the next.
+      if (drop && j >= previousEnd) break;
+    }
+
+    auto live = [&](const AffineCell & c) {
+      return std::max({c.Match, c.Insertion, c.Deletion}) > inf;
+    };
+    auto firstLive = std::find_if(current.begin(), current.end(), live);
+    if (firstLive == current.end()) break;
+    auto lastLive = std::find_if(current.rbegin(), current.rend(), live).base();
+
+    previousFirst = first + (firstLive - current.begin());
+    previous.assign(firstLive, lastLive);
+  }
+
+  Cigar actionStack;
+  size_t i = bestI, j = bestJ;
+  State state = DirectionMatrix::FromMatch;
+  while (i != 0 || j != 0) {
+    const Row & row = rows[i];
+    State from = DirectionMatrix::From(row.directions[j - row.first], state);
+
+    switch (state) {
+      case DirectionMatrix::FromMatch:
+        actionStack.push_back(
+            a[i - 1] == b[j - 1] ? Action::Match : Action::Mismatch);
+        --i;
+        --j;
+        break;
+      case DirectionMatrix::FromInsertion:
+        actionStack.push_back(Action::Insertion);
+        --j;
+        break;
+      case DirectionMatrix::FromDeletion:
+        actionStack.push_back(Action::Deletion);
+        --i;
+        break;
+    }
+
+    state = from;
+  }
+
+  return std::make_tuple(actionStack, bestI, bestJ, best);
+}
+
+//! \brief The X-drop alignment around an exact seed.
+//!
+//! The alignment is extended with XDropExtend to the right of the seed and,
+//! on the reversed sequences, to its left.  Unlike Alignment(s1, s2, S,
+//! local_alignment_tag()) it always contains the seed and it only fills the
+//! cells close to the best path, so bad candidates stop after a few rows.
+//!
+//! \param s1 The first sequence
+//! \param s2 The second sequence
+//! \param S  The score table
+//! \param seedI The position of the seed in s1
+//! \param seedJ The position of the seed in s2
+//! \param seedLength The length of the seed
+//! \param X The drop from the best score that ends the extensions
+//! \returns The alignment of s1 and s2
+inline Cigar
+XDropAlignment(const Sequence &s1, const Sequence &s2, const ScoreTable &S,
+               size_t seedI, size_t seedJ, size_t seedLength, ssize_t X) {
+  using ReverseItr = std::reverse_iterator<Sequence::const_iterator>;
+
+  const size_t seedEndI = seedI + seedLength;
+  const size_t seedEndJ = seedJ + seedLength;
+
+  Cigar right, left;
+  size_t rightI, rightJ, leftI, leftJ;
+  std::tie(right, rightI, rightJ, std::ignore) = XDropExtend(
+      s1.begin() + seedEndI, s1.length() - seedEndI,
+      s2.begin() + seedEndJ, s2.length() - seedEndJ, S, X);
+  std::tie(left, leftI, leftJ, std::ignore) = XDropExtend(
+      ReverseItr(s1.begin() + seedI), seedI,
+      ReverseItr(s2.begin() + seedJ), seedJ, S, X);
+
+  // The runs go from the end to the beginning of the alignment.
+  Cigar actionStack(std::move(right));
+  actionStack.push_back(Action::Match, seedLength);
+  for (auto itr = left.runs().rbegin(), end = left.runs().rend();
+       itr != end; ++itr)
+    actionStack.push_back(itr->action, itr->length);
+
+  actionStack.SetCoordinates(s1.length(), s2.length(),
+                             seedI - leftI, seedJ - leftJ,
+                             seedEndI + rightI, seedEndJ + rightJ);
+
+  return actionStack;
+}
+
+}  // namespace cpts571
+
+#endif  // XDROP_ALIGNMENT_H
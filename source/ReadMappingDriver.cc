@@ -16,11 +16,30 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <thread>
 
+#include "cpts571/AsyncWriter.h"
+#include "cpts571/BandedAlignment.h"
+#include "cpts571/BatchedAlignment.h"
+#include "cpts571/BoundedQueue.h"
+#include "cpts571/ContigTable.h"
+#include "cpts571/EditDistance.h"
 #include "cpts571/SequenceParserDriver.h"
+#include "cpts571/StripedAlignment.h"
 #include "cpts571/ReadMappingDriver.h"
+#include "cpts571/XDropAlignment.h"
 
 #include "rapidjson/document.h"
 #include "rapidjson/rapidjson.h"
@@ -28,16 +47,43 @@
 
 namespace cpts571 {
 
+namespace {
+
+//! \brief The name of a sequence up to its first blank, as required by SAM.
+std::string ShortName(const Sequence & s) {
+  std::string name = s.Name();
+  return name.substr(0, name.find_first_of(" \t"));
+}
+
+//! \brief The QUAL field of SAM, * for the sequences without qualities.
+std::string SamQuality(const Sequence & s) {
+  return s.Quality().empty() ? "*" : s.Quality();
+}
+
+//! \brief The character replacing the low quality bases of the reads.
+//!
+//! A control character: the sequence files, the separators of the index and
+//! the alphabets of the substitution matrices hold only printable ones, so
+//! it starts no seed and pairs with nothing but as a mismatch.
+const char MaskedBase = '\x01';
+
+}  // namespace
+
+//! The reads are parsed by the first stage of the pipeline in Exec.
 void
 ReadMappingDriver::Parse(
-    const std::string &GF, const std::string &RF, const std::string &CF) {
+    const std::string &GF, const std::string &, const std::string &CF) {
   SequenceParserDriver SPD(GF);
-  
-  gene_ = std::move(SPD.Parse())[0];
-
-  SequenceParserDriver SPD2(RF);
 
-  reads_ = std::move(SPD2.Parse());
+  // Every record of the reference file is a contig of the index.
+  bool parsed = SPD.Parse([&](Sequence & contig) {
+      contigs_.Append(gene_, ShortName(contig), contig);
+    });
+  if (!parsed) exit(-1);
+  if (contigs_.size() == 0) {
+    std::cerr << "Error: no sequence in " << GF << std::endl;
+    exit(-1);
+  }
 
   std::ifstream configFile(CF.c_str());
 
@@ -51,103 +97,793 @@ ReadMappingDriver::Parse(
   scoreTable_.Mismatch = document["mismatch"].GetInt64();
   scoreTable_.H = document["h"].GetInt64();
   scoreTable_.G = document["g"].GetInt64();
+
+  if (document.HasMember("substitution")) {
+    try {
+      scoreTable_.Substitution = ParseSubstitutionMatrix(
+          document["substitution"], scoreTable_.Match, scoreTable_.Mismatch);
+    } catch (std::invalid_argument & e) {
+      std::cerr << "Error in " << CF << ": " << e.what() << std::endl;
+      exit(-1);
+    }
+  }
 }
 
-void ReadMappingDriver::Exec()  {
-  std::string terminal("$");
-  gene_.AppendChunk(terminal.begin(), terminal.end());
-  std::cout << "# Gene length : " << gene_.length() << std::endl;
-  std::cout << "# Read number : " << reads_.size() << std::endl;
-  SuffixTree ST(gene_, config_.x);
+ReadMappingDriver::MappingStats &
+ReadMappingDriver::MappingStats::operator+=(const MappingStats & other) {
+  readsWithMatches += other.readsWithMatches;
+  totNumberOfMatches += other.totNumberOfMatches;
+  seedLocations += other.seedLocations;
+  droppedCandidates += other.droppedCandidates;
+  exactAlignments += other.exactAlignments;
+  prunedCandidates += other.prunedCandidates;
+  maskedBases += other.maskedBases;
+  trimmedBases += other.trimmedBases;
+  ungappedAlignments += other.ungappedAlignments;
+  skippedAlignments += other.skippedAlignments;
+  PrefilterTime += other.PrefilterTime;
+  return *this;
+}
+
+ReadMappingDriver::ReadSeeds
+ReadMappingDriver::Consolidate(
+    const std::tuple<std::vector<size_t>, size_t, size_t> & seed,
+    size_t readLength, MappingStats & stats) const {
+  ReadSeeds result;
+  const std::vector<size_t> & locations = std::get<0>(seed);
+  result.offset = std::get<1>(seed);
+  result.length = std::get<2>(seed);
+  stats.seedLocations += locations.size();
+
+  // The banded and the x-drop aligners follow the diagonal of a seed, so
+  // only the locations on the same diagonal are merged for them.  The other
+  // aligners search the whole window, and overlapping windows are aligned
+  // once as their union.
+  bool anchored = config_.Aligner == AlignerKind::Banded ||
+                  config_.Aligner == AlignerKind::XDrop;
 
-  std::vector<ssize_t> result;
-  result.reserve(reads_.size());
+  std::vector<size_t> order(locations.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return locations[a] < locations[b];
+    });
 
-  double readsWithMatches = 0;
-  double totNumberOfMatches = 0;
-  auto beginMapReads = std::chrono::steady_clock::now();
-  for (auto & r : reads_) {
-    auto locations = ST.FindLoc(r);
+  auto & candidates = result.candidates;
+  for (auto k : order) {
+    // The windows stop at the ends of the contig of the seed.
+    size_t l = locations[k];
+    size_t contig = contigs_.Find(l);
+    size_t begin = std::max(contigs_.Begin(contig),
+                            l > readLength ? l - readLength : 0);
+    size_t end = std::min(contigs_.End(contig), l + readLength);
 
-    double bestLengthCoverage = 0;
-    ssize_t bestStart = -1;
-    if (locations.size() > 0) {
-      ++readsWithMatches;
-      totNumberOfMatches += locations.size();
+    if (!candidates.empty() &&
+        (candidates.back().location == l ||
+         (!anchored && begin <= candidates.back().end &&
+          contigs_.Find(candidates.back().location) == contig))) {
+      candidates.back().end = std::max(candidates.back().end, end);
+      candidates.back().rank = std::min(candidates.back().rank, k);
+      ++candidates.back().hits;
+    } else {
+      candidates.push_back(Candidate{begin, end, l, 1, k});
     }
-    for (auto l : locations) {
-      ssize_t startPos = std::max<ssize_t>(0, l - r.length());
-      ssize_t endPos = std::min<ssize_t>(gene_.length(), l + r.length());
+  }
 
-      Sequence s;
-      s.AppendChunk(gene_.begin() + startPos, gene_.begin() + endPos);
+  // The windows are aligned in the order of the suffix tree, that decides the
+  // ties between equally good alignments.  The cap keeps the windows with the
+  // most seeds.
+  auto byRank = [](const Candidate & a, const Candidate & b) {
+    return a.rank < b.rank;
+  };
+  std::sort(candidates.begin(), candidates.end(), byRank);
+  if (config_.MaxCandidates != 0 &&
+      candidates.size() > config_.MaxCandidates) {
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const Candidate & a, const Candidate & b) {
+                       return a.hits > b.hits;
+                     });
+    stats.droppedCandidates += candidates.size() - config_.MaxCandidates;
+    candidates.resize(config_.MaxCandidates);
+    std::sort(candidates.begin(), candidates.end(), byRank);
+  }
+  return result;
+}
 
-      auto actions = Alignment(s, r, scoreTable_, local_alignment_tag());
-
-      double matches = 0;
-      double alignLength = 0;
-        
-      for (auto a : actions) {
-        switch (a) {
-          case Action::Match:
-            ++matches;
-          case Action::Insertion:
-          case Action::Deletion:
-            ++alignLength;
-            break;
-          default:
-            break;
-        }
+Sequence
+ReadMappingDriver::MaskLowQuality(
+    const Sequence & r, MappingStats & stats) const {
+  const std::string & quality = r.Quality();
+  if (quality.empty()) return r;
+
+  auto low = [&](size_t i) {
+    return quality[i] < char(33 + config_.MinQuality);
+  };
+
+  // The low quality tail is cut, and the other low quality bases are masked
+  // so that no seed and no match covers them.
+  size_t length = r.length();
+  while (length > 0 && low(length - 1)) --length;
+  stats.trimmedBases += r.length() - length;
+
+  std::string bases(r.begin(), r.begin() + length);
+  for (size_t i = 0; i < length; ++i) {
+    if (low(i)) {
+      bases[i] = MaskedBase;
+      ++stats.maskedBases;
+    }
+  }
+
+  Sequence masked;
+  masked.Name(r.Name());
+  masked.AppendChunk(bases.begin(), bases.end());
+  masked.Quality(quality.substr(0, length));
+  return masked;
+}
+
+void
+ReadMappingDriver::SeedReads(const SuffixTree & ST, ReadBatch & batch) const {
+  if (config_.MinQuality != 0) {
+    batch.masked.reserve(batch.reads.size());
+    for (auto & r : batch.reads)
+      batch.masked.push_back(MaskLowQuality(r, batch.stats));
+  }
+
+  // The reads cut to nothing have no seed.
+  auto seed = [&](const Sequence & r) {
+    if (r.length() == 0) return ReadSeeds();
+    return Consolidate(ST.FindSeed(r), r.length(), batch.stats);
+  };
+
+  const std::vector<Sequence> & reads = batch.Aligned();
+  batch.seeds.reserve(reads.size());
+  for (auto & r : reads) batch.seeds.push_back(seed(r));
+  if (!config_.BothStrands) return;
+
+  // The reverse strand is searched on the same tree as the reverse
+  // complement of the read.
+  batch.reverse.reserve(reads.size());
+  batch.reverseSeeds.reserve(reads.size());
+  for (auto & r : reads) {
+    batch.reverse.push_back(ReverseComplement(r));
+    batch.reverseSeeds.push_back(seed(batch.reverse.back()));
+  }
+}
+
+bool
+ReadMappingDriver::UngappedAlignment(
+    const Sequence & r, size_t start, bool allowMismatches,
+    Cigar & alignment) const {
+  const ScoreTable & S = scoreTable_;
+  const size_t n = r.length();
+  // The diagonal may not leave the contig where the read starts.
+  if (S.Substitution || S.Match <= S.Mismatch || S.H + S.G >= 0 ||
+      n == 0 || start + n > contigs_.End(contigs_.Find(start)))
+    return false;
+
+  // Every alignment with a gap scores at most as the read with one gap and
+  // no mismatch, so an ungapped alignment scoring more is optimal.
+  const ssize_t gapped = ssize_t(n) * S.Match + S.H + S.G;
+
+  const char * a = &*gene_.begin() + start;
+  const char * b = &*r.begin();
+  std::vector<size_t> mismatches;
+  for (size_t i = 0; i < n;) {
+    uint64_t x, y;
+    if (i + 8 <= n) {
+      std::memcpy(&x, a + i, 8);
+      std::memcpy(&y, b + i, 8);
+      if (x == y) {
+        i += 8;
+        continue;
       }
+    }
+    if (a[i] != b[i]) {
+      if (!allowMismatches) return false;
+      mismatches.push_back(i);
+      if (ssize_t(n - mismatches.size()) * S.Match <= gapped) return false;
+    }
+    ++i;
+  }
+
+  // The local alignment is the best scoring segment of the diagonal, the
+  // semi-global one the whole read.
+  size_t begin = 0, end = n;
+  ssize_t score = ssize_t(n - mismatches.size()) * S.Match +
+                  ssize_t(mismatches.size()) * S.Mismatch;
+  if (config_.Aligner != AlignerKind::SemiGlobal && !mismatches.empty()) {
+    score = 0;
+    ssize_t current = 0;
+    size_t currentBegin = 0;
+    auto next = mismatches.begin();
+    for (size_t i = 0; i < n; ++i) {
+      bool mismatch = next != mismatches.end() && *next == i;
+      if (mismatch) ++next;
+      if (current <= 0) {
+        current = 0;
+        currentBegin = i;
+      }
+      current += mismatch ? S.Mismatch : S.Match;
+      if (current > score) {
+        score = current;
+        begin = currentBegin;
+        end = i + 1;
+      }
+    }
+  }
+  if (score <= gapped) return false;
+
+  alignment = Cigar();
+  size_t j = end;
+  for (auto itr = mismatches.rbegin(); itr != mismatches.rend(); ++itr) {
+    if (*itr >= end || *itr < begin) continue;
+    alignment.push_back(Action::Match, j - *itr - 1);
+    alignment.push_back(Action::Mismatch);
+    j = *itr;
+  }
+  alignment.push_back(Action::Match, j - begin);
+  alignment.SetCoordinates(gene_.length(), n,
+                           start + begin, begin, start + end, end);
+  return true;
+}
+
+void
+ReadMappingDriver::VerifyReads(ReadBatch & batch) {
+  const std::vector<Sequence> & reads = batch.Aligned();
+  MappingStats & stats = batch.stats;
+  std::vector<ReadMapping> & result = batch.result;
+  std::vector<double> bestLengthCoverage(reads.size(), 0);
+  result.assign(reads.size(), ReadMapping());
 
-      double percentIdentity = matches / alignLength;
-      double lengthCoverage = alignLength / r.length();
+  std::vector<size_t> bestRank(reads.size(), 0);
 
+  // Keep the alignment of the read id if it is the best seen so far.  The
+  // ties go to the forward strand and then to the window found last by the
+  // suffix tree, whatever the order the windows are aligned in.
+  auto checkAlignment = [&](size_t id, bool reverse, size_t rank,
+                            ssize_t startPos, const Sequence & window,
+                            Cigar & alignment) {
+    const Sequence & r = reverse ? batch.reverse[id] : reads[id];
+    double matches = alignment.matches();
+    double alignLength = alignment.matches() + alignment.gaps();
+
+    double percentIdentity = matches / alignLength;
+    double lengthCoverage = alignLength / r.length();
+
+    if (percentIdentity >= config_.X && lengthCoverage >= config_.Y &&
+        (bestLengthCoverage[id] < lengthCoverage ||
+         (bestLengthCoverage[id] == lengthCoverage &&
+          ((!reverse && result[id].reverse) ||
+           (reverse == result[id].reverse && rank > bestRank[id]))))) {
+      bestLengthCoverage[id] = lengthCoverage;
+      bestRank[id] = rank;
+
+      // The read starts where the alignment starts on its diagonal.
       size_t delta = 0;
-      if (percentIdentity >= config_.X && lengthCoverage >= config_.Y &&
-          bestLengthCoverage <= lengthCoverage) {
-        bestLengthCoverage = lengthCoverage;
-        for (auto itr = actions.rbegin(), end = actions.rend();
-             itr != end; ++itr) {
-          if (*itr == Action::Match) break;
-          if (*itr == Action::DC_Deletion)
-            ++delta;
+      if (alignment.begin1() > alignment.begin2())
+        delta = alignment.begin1() - alignment.begin2();
+
+      result[id].position = startPos + delta;
+      result[id].window = startPos;
+      result[id].reverse = reverse;
+      result[id].score = AlignmentScore(alignment, window, r, scoreTable_);
+      result[id].alignment = std::move(alignment);
+    }
+  };
+
+  // The windows waiting for the batched aligner.
+  const size_t batchSize = 256;
+  std::vector<Sequence> batchWindows;
+  std::vector<size_t> batchReads;
+  std::vector<bool> batchReverse;
+  std::vector<size_t> batchRanks;
+  std::vector<ssize_t> batchStarts;
+  auto flushBatch = [&]() {
+    std::vector<const Sequence *> windows, queries;
+    for (size_t k = 0; k < batchWindows.size(); ++k) {
+      windows.push_back(&batchWindows[k]);
+      queries.push_back(batchReverse[k] ? &batch.reverse[batchReads[k]]
+                                        : &reads[batchReads[k]]);
+    }
+
+    auto actions = BatchedAlignment(windows, queries, scoreTable_);
+    for (size_t k = 0; k < actions.size(); ++k)
+      checkAlignment(batchReads[k], batchReverse[k], batchRanks[k],
+                     batchStarts[k], batchWindows[k], actions[k]);
+
+    batchWindows.clear();
+    batchReads.clear();
+    batchReverse.clear();
+    batchRanks.clear();
+    batchStarts.clear();
+  };
+
+  for (size_t id = 0; id < reads.size(); ++id) {
+    // The windows of both strands, from the longest seed and the most seeds,
+    // so that the best alignment is likely found first and bounds the
+    // others.
+    std::vector<std::pair<bool, const Candidate *>> candidates;
+    for (bool reverse : { false, true }) {
+      if (reverse && !config_.BothStrands) break;
+      const auto & seed = reverse ? batch.reverseSeeds[id] : batch.seeds[id];
+      for (auto & candidate : seed.candidates)
+        candidates.emplace_back(reverse, &candidate);
+    }
+    if (candidates.empty()) continue;
+
+    ++stats.readsWithMatches;
+    stats.totNumberOfMatches += candidates.size();
+
+    auto seedLengthOf = [&](bool reverse) {
+      return reverse ? batch.reverseSeeds[id].length : batch.seeds[id].length;
+    };
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [&](const std::pair<bool, const Candidate *> & a,
+                         const std::pair<bool, const Candidate *> & b) {
+                       size_t lengthA = seedLengthOf(a.first);
+                       size_t lengthB = seedLengthOf(b.first);
+                       if (lengthA != lengthB) return lengthA > lengthB;
+                       return a.second->hits > b.second->hits;
+                     });
+
+    std::unique_ptr<StripedQueryProfile> profiles[2];
+    std::unique_ptr<BitParallelPattern> patterns[2];
+    for (auto & job : candidates) {
+      bool reverse = job.first;
+      const Candidate & candidate = *job.second;
+      const Sequence & r = reverse ? batch.reverse[id] : reads[id];
+      const auto & seed = reverse ? batch.reverseSeeds[id] : batch.seeds[id];
+      size_t seedOffset = seed.offset;
+      size_t seedLength = seed.length;
+      if (!profiles[reverse]) {
+        profiles[reverse].reset(new StripedQueryProfile(r, scoreTable_));
+        patterns[reverse].reset(new BitParallelPattern(r));
+      }
+
+      ssize_t l = candidate.location;
+      ssize_t startPos = candidate.begin;
+      ssize_t endPos = candidate.end;
+
+      // A seed as long as the read is an exact match, and a read close to
+      // the gene on the diagonal of its seed needs no dynamic programming.
+      // These alignments are placed on the whole gene.
+      Cigar ungapped;
+      if (seedLength == r.length() && !scoreTable_.Substitution) {
+        ungapped.push_back(Action::Match, r.length());
+        ungapped.SetCoordinates(gene_.length(), r.length(),
+                                l, 0, l + r.length(), r.length());
+        ++stats.exactAlignments;
+        checkAlignment(id, reverse, candidate.rank, 0, gene_, ungapped);
+        continue;
+      }
+      // The other seeds merged in the window may sit on diagonals with fewer
+      // mismatches.
+      if (l >= ssize_t(seedOffset) &&
+          UngappedAlignment(r, l - seedOffset, candidate.hits == 1,
+                            ungapped)) {
+        ++stats.ungappedAlignments;
+        checkAlignment(id, reverse, candidate.rank, 0, gene_, ungapped);
+        continue;
+      }
+
+      // The edit distance of the read to the window bounds the coverage of
+      // its alignments by min(1/X, (|r| - d) / ((2X - 1) |r|)).  Windows too
+      // far from the read cannot pass the identity and coverage thresholds,
+      // or once an alignment is found cannot reach its coverage, whatever
+      // the aligner.
+      if (config_.Prefilter) {
+        double target = std::max(config_.Y, bestLengthCoverage[id]);
+        size_t maxDistance =
+            EditDistanceBound(r.length(), config_.X, target);
+
+        auto beginPrefilter = std::chrono::steady_clock::now();
+        bool within = patterns[reverse]->WithinDistance(
+            gene_.begin() + startPos, gene_.begin() + endPos, maxDistance);
+        auto endPrefilter = std::chrono::steady_clock::now();
+        stats.PrefilterTime += std::chrono::duration_cast<
+          std::chrono::duration<double> >(
+              endPrefilter - beginPrefilter).count();
+
+        if (!within) {
+          if (target > config_.Y)
+            ++stats.prunedCandidates;
+          else
+            ++stats.skippedAlignments;
+          continue;
         }
+      }
+
+      Sequence s;
+      s.AppendChunk(gene_.begin() + startPos, gene_.begin() + endPos);
 
-        bestStart = startPos + delta;
+      if (config_.Aligner == AlignerKind::Batched) {
+        batchWindows.push_back(std::move(s));
+        batchReads.push_back(id);
+        batchReverse.push_back(reverse);
+        batchRanks.push_back(candidate.rank);
+        batchStarts.push_back(startPos);
+        if (batchWindows.size() == batchSize) flushBatch();
+        continue;
+      }
+
+      Cigar actions;
+      if (config_.Aligner == AlignerKind::Banded) {
+        // The seed starts at l in the gene and at seedOffset in the read.
+        ssize_t diagonal = (l - startPos) - seedOffset;
+        actions = BandedAlignment(s, r, scoreTable_, local_alignment_tag(),
+                                  diagonal, config_.BandWidth);
+      } else if (config_.Aligner == AlignerKind::Striped) {
+        actions = StripedAlignment(s, *profiles[reverse]);
+      } else if (config_.Aligner == AlignerKind::XDrop) {
+        actions = XDropAlignment(s, r, scoreTable_, l - startPos, seedOffset,
+                                 seedLength, config_.XDrop);
+      } else if (config_.Aligner == AlignerKind::SemiGlobal) {
+        actions = Alignment(s, r, scoreTable_, semiglobal_alignment_tag());
+      } else {
+        actions = Alignment(s, r, scoreTable_, local_alignment_tag());
       }
-    }
 
-    result.push_back(bestStart);
+      checkAlignment(id, reverse, candidate.rank, startPos, s, actions);
+    }
   }
-  auto endMapReads = std::chrono::steady_clock::now();
-  double MapReadsTime = std::chrono::duration_cast<
-    std::chrono::duration<double> >(endMapReads - beginMapReads).count();
+  flushBatch();
+}
 
-  std::cout << "# MapReads completed in " << MapReadsTime
-            << "\n# Average number of alignment per read (w/ hits) : " << totNumberOfMatches/readsWithMatches
-            << std::endl;
+void
+ReadMappingDriver::PrintHeader(std::ostream & O) const {
+  if (config_.Format != OutputFormat::SAM) return;
+
+  O << "@HD\tVN:1.6\tSO:unsorted\n";
+  for (size_t i = 0; i < contigs_.size(); ++i)
+    O << "@SQ\tSN:" << contigs_.Name(i) << "\tLN:" << contigs_.Length(i)
+      << '\n';
+  O << "@PG\tID:read_mapping_tool\tPN:read_mapping_tool\n";
+}
+
+void
+ReadMappingDriver::PrintResults(
+    const ReadBatch & batch, std::ostream & O) const {
+  for (size_t id = 0; id < batch.reads.size(); ++id) {
+    const Sequence & r = batch.reads[id];
+    const Sequence & a = batch.Aligned()[id];
+    // The bases cut from the 3' end of the read before its alignment.
+    const size_t trimmed = r.length() - a.length();
+    const ReadMapping & m = batch.result[id];
+    const Cigar & C = m.alignment;
+    char strand = m.reverse ? '-' : '+';
+
+    // The mappings are reported on the contig where their alignment starts.
+    size_t contig = contigs_.Find(m.window + C.begin1());
+    const std::string & contigName = contigs_.Name(contig);
+    size_t offset = contigs_.Begin(contig);
 
-  
-  auto beginOutput = std::chrono::steady_clock::now();
+    if (config_.Format == OutputFormat::Native) {
+      if (m.position != -1)
+        O << r.Name() << " " << contigName
+          << " " << m.position - offset
+          << " " << m.position - offset + a.length() << " " << strand << '\n';
+      else
+        O << r.Name() << " No Hit Found" << '\n';
+      continue;
+    }
+
+    // The reads without a hit are listed as unmapped by SAM and left out of
+    // PAF.
+    if (m.position == -1) {
+      if (config_.Format == OutputFormat::SAM)
+        O << ShortName(r) << "\t4\t*\t0\t0\t*\t*\t0\t0\t"
+          << std::string(r.begin(), r.end()) << '\t' << SamQuality(r) << '\n';
+      continue;
+    }
 
-  auto itrRes = result.begin();
-  for (auto itrReads = reads_.begin(), endReads = reads_.end();
-       itrReads != endReads; ++itrReads, ++itrRes) {
-    if (*itrRes != -1) {
-      std::cout << itrReads->Name()
-                << " " << *itrRes << " " << *itrRes + itrReads->length()
-                << std::endl;
+    double identity = C.length() ? double(C.matches()) / C.length() : 0;
+    size_t distance = C.mismatches() + C.gaps();
+    if (config_.Format == OutputFormat::SAM) {
+      // The parts of the read outside the local alignment, and its trimmed
+      // tail, are soft clipped.  The reads on the reverse strand are reported
+      // as their reverse complement, in the direction of the gene, where the
+      // tail comes first.
+      Sequence reverse;
+      if (m.reverse && !batch.masked.empty()) reverse = ReverseComplement(r);
+      const Sequence & sequence = !m.reverse ? r
+          : batch.masked.empty() ? batch.reverse[id] : reverse;
+      size_t head = C.begin2() + (m.reverse ? trimmed : 0);
+      size_t tail = a.length() - C.end2() + (m.reverse ? 0 : trimmed);
+      O << ShortName(r) << '\t' << (m.reverse ? 16 : 0) << '\t' << contigName
+        << '\t' << m.window + C.begin1() - offset + 1 << "\t255\t";
+      if (head > 0) O << head << 'S';
+      O << C;
+      if (tail > 0) O << tail << 'S';
+      O << "\t*\t0\t0\t" << std::string(sequence.begin(), sequence.end())
+        << '\t' << SamQuality(sequence)
+        << "\tAS:i:" << m.score << "\tNM:i:" << distance
+        << "\tXI:f:" << identity << '\n';
     } else {
-      std::cout << itrReads->Name() << " No Hit Found"<< std::endl;
+      // The coordinates on the read are on its own strand.
+      size_t begin = m.reverse ? a.length() - C.end2() : C.begin2();
+      size_t end = m.reverse ? a.length() - C.begin2() : C.end2();
+      O << ShortName(r) << '\t' << r.length()
+        << '\t' << begin << '\t' << end << '\t' << strand << '\t'
+        << contigName << '\t' << contigs_.Length(contig)
+        << '\t' << m.window + C.begin1() - offset
+        << '\t' << m.window + C.end1() - offset
+        << '\t' << C.matches() << '\t' << C.length() << "\t255"
+        << "\tAS:i:" << m.score << "\tNM:i:" << distance
+        << "\tXI:f:" << identity << "\tcg:Z:" << C << '\n';
+    }
+  }
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double Seconds(Clock::time_point begin, Clock::time_point end) {
+  return std::chrono::duration_cast<
+    std::chrono::duration<double> >(end - begin).count();
+}
+
+//! \brief The work of a thread of a stage of the pipeline.
+struct StageStats {
+  size_t batches = 0;
+  size_t reads = 0;
+  //! The time spent on the batches.
+  double busy = 0;
+  //! The time spent waiting on the queues.
+  double waiting = 0;
+};
+
+//! \brief Run f on the batches of in and pass them to out.
+//!
+//! The last of the active threads of the stage closes out.
+template <typename Batch, typename F>
+void StageWorker(BoundedQueue<Batch> & in, BoundedQueue<Batch> & out,
+                 std::atomic<size_t> & active, StageStats & stats, F f) {
+  for (Batch batch;;) {
+    auto beginPop = Clock::now();
+    bool more = in.Pop(batch);
+    auto endPop = Clock::now();
+    stats.waiting += Seconds(beginPop, endPop);
+    if (!more) break;
+
+    f(*batch);
+    ++stats.batches;
+    stats.reads += batch->reads.size();
+    auto beginPush = Clock::now();
+    stats.busy += Seconds(endPop, beginPush);
+
+    out.Push(std::move(batch));
+    stats.waiting += Seconds(beginPush, Clock::now());
+  }
+
+  if (--active == 0) out.Close();
+}
+
+//! \brief The batches that may exist past the next one to write.
+//!
+//! The parser takes a ticket before starting a batch and the writer returns
+//! one every time it writes the next batch, so a batch held up in a stage
+//! keeps at most size batches waiting for it.
+class ReorderWindow {
+ public:
+  explicit ReorderWindow(size_t size)
+      : size_(size), next_(0), maxPending_(0), fullWaits_(0) {}
+
+  //! \brief Wait until the batch id is within the window.
+  void Acquire(size_t id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (id >= next_ + size_) {
+      ++fullWaits_;
+      cv_.wait(lock, [&]() { return id < next_ + size_; });
     }
   }
 
-  auto endOutput = std::chrono::steady_clock::now();
-  double OutputTime = std::chrono::duration_cast<
-    std::chrono::duration<double> >(endOutput - beginOutput).count();
+  //! \brief Move the window past the next batch.
+  //! \param pending The batches written so far waiting for it
+  void Release(size_t pending) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++next_;
+      maxPending_ = std::max(maxPending_, pending);
+    }
+    cv_.notify_one();
+  }
+
+  size_t size() const { return size_; }
+  size_t maxPending() const { return maxPending_; }
+  size_t fullWaits() const { return fullWaits_; }
+
+ private:
+  const size_t size_;
+  size_t next_;
+  size_t maxPending_;
+  size_t fullWaits_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+void PrintStage(const std::string & name,
+                const std::vector<StageStats> & threads) {
+  StageStats stage;
+  for (auto & stats : threads) {
+    stage.batches += stats.batches;
+    stage.reads += stats.reads;
+    stage.busy += stats.busy;
+    stage.waiting += stats.waiting;
+  }
+
+  std::cout << "# Stage " << name << " : " << threads.size() << " threads, "
+            << stage.reads << " reads in " << stage.batches << " batches"
+            << ", busy " << stage.busy << "s, waiting " << stage.waiting
+            << "s, " << (stage.busy > 0 ? stage.reads / stage.busy : 0)
+            << " reads/s per thread" << std::endl;
+}
+
+void PrintQueue(const std::string & name, const QueueStats & stats) {
+  std::cout << "# Queue " << name << " : mean occupancy "
+            << stats.meanOccupancy << " of " << stats.capacity
+            << ", max " << stats.maxOccupancy
+            << ", full " << stats.fullWaits << " times"
+            << ", empty " << stats.emptyWaits << " times" << std::endl;
+}
+
+void PrintWindow(const ReorderWindow & window) {
+  std::cout << "# Reorder window : " << window.size() << " batches"
+            << ", max " << window.maxPending() << " waiting to be written"
+            << ", full " << window.fullWaits() << " times" << std::endl;
+}
+
+}  // namespace
+
+void ReadMappingDriver::Exec()  {
+  std::string terminal("$");
+  gene_.AppendChunk(terminal.begin(), terminal.end());
+  std::cout << "# Gene length : " << gene_.length()
+            << "\n# Contigs : " << contigs_.size() << std::endl;
+  SuffixTree ST(gene_, config_.x);
+
+  using BatchPtr = std::unique_ptr<ReadBatch>;
+  const size_t depth = 4;
+  BoundedQueue<BatchPtr> parsed(depth), seeded(depth), verified(depth);
+  // As many batches as the queues and the threads hold, so the parser waits
+  // only for a batch held up in a stage.
+  ReorderWindow window(
+      parsed.capacity() + seeded.capacity() + verified.capacity() +
+      config_.SeedThreads + config_.Threads);
+
+  std::vector<StageStats> parseStats(1), seedStats(config_.SeedThreads);
+  std::vector<StageStats> verifyStats(config_.Threads), writeStats(1);
+  std::atomic<size_t> activeSeeders(config_.SeedThreads);
+  std::atomic<size_t> activeVerifiers(config_.Threads);
+
+  auto beginMapReads = Clock::now();
+
+  // A reads file that cannot be parsed ends the pipeline early, and the tool
+  // exits once the other threads and the output are done.
+  bool parseFailed = false;
+
+  std::vector<std::thread> threads;
+  threads.emplace_back([&]() {
+      StageStats & stats = parseStats[0];
+      BatchPtr batch(new ReadBatch);
+      size_t id = 0;
+      auto last = Clock::now();
+      auto push = [&]() {
+        batch->id = id++;
+        ++stats.batches;
+        stats.reads += batch->reads.size();
+        auto beginPush = Clock::now();
+        stats.busy += Seconds(last, beginPush);
+        parsed.Push(std::move(batch));
+        window.Acquire(id);
+        last = Clock::now();
+        stats.waiting += Seconds(beginPush, last);
+        batch.reset(new ReadBatch);
+      };
+
+      SequenceParserDriver SPD(config_.ReadsFileName);
+      parseFailed = !SPD.Parse([&](Sequence & read) {
+          batch->reads.emplace_back(std::move(read));
+          if (batch->reads.size() == config_.BatchSize) push();
+        });
+      if (!batch->reads.empty()) push();
+      stats.busy += Seconds(last, Clock::now());
+      parsed.Close();
+    });
+
+  for (size_t t = 0; t < config_.SeedThreads; ++t)
+    threads.emplace_back([&, t]() {
+        StageWorker(parsed, seeded, activeSeeders, seedStats[t],
+                    [&](ReadBatch & batch) { SeedReads(ST, batch); });
+      });
+
+  for (size_t t = 0; t < config_.Threads; ++t)
+    threads.emplace_back([&, t]() {
+        StageWorker(seeded, verified, activeVerifiers, verifyStats[t],
+                    [&](ReadBatch & batch) { VerifyReads(batch); });
+      });
+
+  std::ofstream outputFile;
+  if (!config_.OutputFileName.empty()) {
+    outputFile.open(config_.OutputFileName);
+    if (!outputFile.good()) {
+      std::cerr << "Error opening " << config_.OutputFileName << std::endl;
+      exit(-1);
+    }
+  }
+  std::ostream & O = outputFile.is_open() ? outputFile : std::cout;
+  AsyncWriter writer(O);
+  std::ostringstream block;
+  PrintHeader(block);
+
+  // The writer, on this thread, formats the batches in the order of the file
+  // and hands them to the output thread.  A batch arriving early waits for
+  // the ones before it.
+  MappingStats stats;
+  std::map<size_t, BatchPtr> pending;
+  size_t next = 0;
+  for (BatchPtr batch;;) {
+    auto beginPop = Clock::now();
+    bool more = verified.Pop(batch);
+    auto endPop = Clock::now();
+    writeStats[0].waiting += Seconds(beginPop, endPop);
+    if (!more) break;
+
+    pending.emplace(batch->id, std::move(batch));
+    for (auto itr = pending.begin();
+         itr != pending.end() && itr->first == next;
+         itr = pending.erase(itr), ++next) {
+      window.Release(pending.size() - 1);
+      PrintResults(*itr->second, block);
+      writer.Write(block.str());
+      block.str("");
+      stats += itr->second->stats;
+      ++writeStats[0].batches;
+      writeStats[0].reads += itr->second->reads.size();
+    }
+    writeStats[0].busy += Seconds(endPop, Clock::now());
+  }
+
+  for (auto & t : threads) t.join();
+  writer.Write(block.str());
+  writer.Close();
+  if (parseFailed) exit(-1);
+  double MapReadsTime = Seconds(beginMapReads, Clock::now());
+
+  std::cout << "# Read number : " << writeStats[0].reads
+            << "\n# MapReads completed in " << MapReadsTime
+            << "\n# Average number of alignment per read (w/ hits) : " << stats.totNumberOfMatches/stats.readsWithMatches
+            << " (" << (stats.totNumberOfMatches - stats.prunedCandidates) /
+                       stats.readsWithMatches
+            << " after pruning " << stats.prunedCandidates
+            << " candidates that cannot beat the best alignment)"
+            << "\n# Candidates : " << stats.seedLocations
+            << " seed locations merged in " << stats.totNumberOfMatches
+            << " windows, " << stats.droppedCandidates
+            << " windows dropped by the cap"
+            << "\n# Low quality bases : " << stats.maskedBases
+            << " masked and " << stats.trimmedBases << " trimmed"
+            << "\n# Aligned without dynamic programming : "
+            << stats.exactAlignments << " exact and "
+            << stats.ungappedAlignments << " ungapped windows"
+            << "\n# Prefilter skipped " << stats.skippedAlignments << " of "
+            << stats.totNumberOfMatches << " alignments in "
+            << stats.PrefilterTime
+            << std::endl;
+
+  PrintStage("parse", parseStats);
+  PrintStage("seed", seedStats);
+  PrintStage("verify", verifyStats);
+  PrintStage("write", writeStats);
+  PrintQueue("parse -> seed", parsed.Stats());
+  PrintQueue("seed -> verify", seeded.Stats());
+  PrintQueue("verify -> write", verified.Stats());
+  PrintWindow(window);
 
-  std::cout << "# Output completed in " << OutputTime
+  const WriterStats & output = writer.Stats();
+  std::cout << "# Output completed in " << writeStats[0].busy
+            << "\n# Output written in " << output.blocks << " blocks of "
+            << output.bytes << " bytes, writing " << output.writeTime
+            << "s, waiting " << output.waitTime << "s"
             << std::endl;
 }
 
@@ -16,14 +16,24 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <cassert>
+#include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <mutex>
+#include <sstream>
+#include <utility>
 
 #include "cpts571/SequenceAlignmentDriver.h"
 #include "cpts571/SequenceParserDriver.h"
 #include "cpts571/Alignment.h"
+#include "cpts571/CompactAlignment.h"
+#include "cpts571/LinearSpaceAlignment.h"
 #include "cpts571/Sequence.h"
+#include "cpts571/ThreadPool.h"
+#include "cpts571/WavefrontAlignment.h"
+#include "cpts571/WFAAlignment.h"
 
 #include "rapidjson/document.h"
 #include "rapidjson/rapidjson.h"
@@ -49,28 +59,214 @@ SequenceAlignmentDriver::Parse(const std::string &IF, const std::string &CF) {
   S_.Mismatch = document["mismatch"].GetInt64();
   S_.H = document["h"].GetInt64();
   S_.G = document["g"].GetInt64();
+
+  if (document.HasMember("substitution")) {
+    try {
+      S_.Substitution = ParseSubstitutionMatrix(
+          document["substitution"], S_.Match, S_.Mismatch);
+    } catch (std::invalid_argument & e) {
+      std::cerr << "Error in " << CF << ": " << e.what() << std::endl;
+      exit(-1);
+    }
+  }
+}
+
+//! \brief Align s1 and s2 within a memory budget.
+//!
+//! The full table first, then only the traceback directions (one byte per
+//! cell) and then linear space.
+static Cigar
+AlignPair(const Sequence & s1, const Sequence & s2, ScoreTable & S,
+          bool isGlobal, size_t memoryBudget) {
+  size_t cells = (s1.length() + 1) * (s2.length() + 1);
+  size_t matrixSize = cells * AlignmentCellSize(s1, s2, S);
+
+  if (matrixSize <= memoryBudget && isGlobal)
+    return Alignment(s1, s2, S, global_alignment_tag());
+  else if (matrixSize <= memoryBudget)
+    return Alignment(s1, s2, S, local_alignment_tag());
+  else if (cells <= memoryBudget && isGlobal)
+    return CompactAlignment(s1, s2, S, global_alignment_tag());
+  else if (cells <= memoryBudget)
+    return CompactAlignment(s1, s2, S, local_alignment_tag());
+  else if (isGlobal)
+    return Alignment(s1, s2, S, linear_space_global_alignment_tag());
+  return Alignment(s1, s2, S, linear_space_local_alignment_tag());
+}
+
+//! \brief The optimal score of s1 and s2 and where the alignment ends.
+//!
+//! Global alignments with wfa try the wavefronts first, keeping only the last
+//! few, and fall back to two rows of the table when they exceed the budget.
+static std::tuple<size_t, size_t, ssize_t>
+ScorePair(const Sequence & s1, const Sequence & s2, ScoreTable & S,
+          bool isGlobal, bool wfa, size_t memoryBudget) {
+  ssize_t score = 0;
+  if (wfa && isGlobal && WFAAligner::Supports(S) &&
+      WFAAligner(s1, s2, S).Score(memoryBudget, score))
+    return std::make_tuple(s1.length(), s2.length(), score);
+
+  if (isGlobal)
+    return AlignmentScore(s1, s2, S, global_alignment_tag());
+  return AlignmentScore(s1, s2, S, local_alignment_tag());
 }
 
 void
 SequenceAlignmentDriver::AlignSequences() {
   assert(sequences_.size() == 2);
 
-  if (isGlobal_) {
-    actions_ = Alignment(sequences_[0], sequences_[1], S_, global_alignment_tag());
+  if (scoreOnly_) {
+    score_ = ScorePair(sequences_[0], sequences_[1], S_,
+                       isGlobal_, wfa_, memoryBudget_);
+    return;
+  }
+
+  // The wavefronts of divergent sequences take more than the table, which
+  // then computes the alignment within the budget.
+  if (wfa_ && isGlobal_ && WFAAligner::Supports(S_) &&
+      WFAAligner(sequences_[0], sequences_[1], S_).Align(memoryBudget_,
+                                                          alignment_))
+    return;
+
+  size_t cells = (sequences_[0].length() + 1) * (sequences_[1].length() + 1);
+  size_t matrixSize =
+      cells * AlignmentCellSize(sequences_[0], sequences_[1], S_);
+
+  if (matrixSize <= memoryBudget_ && threads_ > 1) {
+    ThreadPool pool(threads_);
+    if (isGlobal_)
+      alignment_ = WavefrontAlignment(sequences_[0], sequences_[1], S_,
+                                    global_alignment_tag(), pool);
+    else
+      alignment_ = WavefrontAlignment(sequences_[0], sequences_[1], S_,
+                                    local_alignment_tag(), pool);
+  } else {
+    alignment_ = AlignPair(sequences_[0], sequences_[1], S_,
+                           isGlobal_, memoryBudget_);
+  }
+}
+
+void
+SequenceAlignmentDriver::AlignPairs() {
+  const size_t columns = sequences_.size();
+  const size_t rows = pairs_ == AlignmentPairs::All ? columns : 1;
+
+  std::vector<std::pair<size_t, size_t>> pairs;
+  for (size_t i = 0; i < rows; ++i)
+    for (size_t j = i + 1; j < columns; ++j)
+      pairs.emplace_back(i, j);
+
+  // Longest processing time first: the largest tables start right away and
+  // the smallest fill the gaps at the end.
+  auto cells = [this](const std::pair<size_t, size_t> & p) {
+    return (sequences_[p.first].length() + 1) *
+        (sequences_[p.second].length() + 1);
+  };
+  std::stable_sort(pairs.begin(), pairs.end(),
+                   [&](const std::pair<size_t, size_t> & a,
+                       const std::pair<size_t, size_t> & b) {
+                     return cells(a) > cells(b);
+                   });
+
+  ThreadPool pool(threads_);
+  const size_t memoryBudget = memoryBudget_ / pool.size();
+
+  // The scores of the matrix and the pairs each row still waits for.
+  std::vector<ssize_t> scores(matrix_ ? rows * columns : 0);
+  std::vector<size_t> pending(rows, 0);
+  for (auto & p : pairs) {
+    ++pending[p.first];
+    if (p.second < rows) ++pending[p.second];
+  }
+  size_t nextRow = 0;
+
+  auto printRows = [&]() {
+    for (; nextRow < rows && pending[nextRow] == 0; ++nextRow) {
+      std::cout << sequences_[nextRow].Name();
+      for (size_t j = 0; j < columns; ++j) {
+        std::cout << '\t';
+        if (j == nextRow)
+          std::cout << '-';
+        else
+          std::cout << scores[nextRow * columns + j];
+      }
+      std::cout << '\n';
+    }
+    std::cout << std::flush;
+  };
+
+  if (matrix_) {
+    for (auto & s : sequences_) std::cout << '\t' << s.Name();
+    std::cout << '\n';
+  } else if (scoreOnly_) {
+    std::cout << "s1\ts2\tscore\tend1\tend2\n";
   } else {
-    actions_ = Alignment(sequences_[0], sequences_[1], S_, local_alignment_tag());
+    std::cout << "s1\ts2\tscore\tmatches\tmismatches\tgaps\topening_gaps\t"
+                 "identity\n";
   }
+
+  std::mutex mutex;
+  pool.StealingFor(pairs.size(), [&](size_t k) {
+      size_t i, j;
+      std::tie(i, j) = pairs[k];
+      const Sequence & s1 = sequences_[i];
+      const Sequence & s2 = sequences_[j];
+
+      std::ostringstream summary;
+      ssize_t score;
+      if (scoreOnly_) {
+        size_t end1, end2;
+        std::tie(end1, end2, score) =
+            ScorePair(s1, s2, S_, isGlobal_, wfa_, memoryBudget);
+        summary << score << '\t' << end1 << '\t' << end2;
+      } else {
+        Cigar alignment;
+        if (!(wfa_ && isGlobal_ && WFAAligner::Supports(S_) &&
+              WFAAligner(s1, s2, S_).Align(memoryBudget, alignment)))
+          alignment = AlignPair(s1, s2, S_, isGlobal_, memoryBudget);
+        score = AlignmentScore(alignment, s1, s2, S_);
+        summary << score << '\t' << alignment.matches()
+                << '\t' << alignment.mismatches()
+                << '\t' << alignment.gaps()
+                << '\t' << alignment.openingGaps()
+                << '\t' << std::fixed << std::setprecision(2)
+                << (alignment.length() ?
+                    100.0 * alignment.matches() / alignment.length() : 0.0);
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!matrix_) {
+        std::cout << s1.Name() << '\t' << s2.Name() << '\t'
+                  << summary.str() << std::endl;
+        return;
+      }
+
+      scores[i * columns + j] = score;
+      --pending[i];
+      if (j < rows) {
+        scores[j * columns + i] = score;
+        --pending[j];
+      }
+      printRows();
+    });
+
+  if (matrix_) printRows();
 }
 
 static void
-PrintAlignment(const Sequence & s1, const Sequence & s2,
-               std::deque<Action> & actions) {
+PrintSequences(const Sequence & s1, const Sequence & s2) {
   std::cout
       << "s1 = \"" << s1.Name() << "\", length = " << s1.length() << " characters"
       << std::endl
       << "s2 = \"" << s2.Name() << "\", length = " << s2.length() << " characters"
       << "\n"
       << std::endl;
+}
+
+static void
+PrintAlignment(const Sequence & s1, const Sequence & s2,
+               const std::deque<Action> & actions) {
+  PrintSequences(s1, s2);
 
   size_t i = 0;
   size_t j = 0;
@@ -138,63 +334,30 @@ PrintAlignment(const Sequence & s1, const Sequence & s2,
 
 static void
 PrintScoreTable(ScoreTable & S) {
-  std::cout << "Scores:\t\t"
-            << "match = " << S.Match
-            << ", mismatch = " << S.Mismatch
-            << ", h = " << S.H
+  std::cout << "Scores:\t\t";
+  if (S.Substitution)
+    std::cout << "matrix = " << S.Substitution->Name();
+  else
+    std::cout << "match = " << S.Match
+              << ", mismatch = " << S.Mismatch;
+  std::cout << ", h = " << S.H
             << ", g = " << S.G << '\n'
             << std::endl;      
 }
 
 static void
-PrintReport(std::deque<Action> & actions, ScoreTable & S) {
-  size_t openingGaps = 0;
-  size_t gaps = 0;
-  size_t matches = 0;
-  size_t mismatches = 0;
-
-  bool inDeletionGap  = false;
-  bool inInsertionGap = false;
-
-  for (auto action : actions) {
-    switch (action) {
-      case Action::Match:
-        ++matches;
-        if (inInsertionGap) inInsertionGap = false;
-        if (inDeletionGap) inDeletionGap = false;
-        break;
-      case Action::Mismatch:
-        ++mismatches;
-        if (inInsertionGap) inInsertionGap = false;
-        if (inDeletionGap) inDeletionGap = false;
-        break;
-      case Action::Insertion:
-        if (!inInsertionGap) {
-          inInsertionGap = true;
-          ++openingGaps;
-        }
-        ++gaps;
-        if (inDeletionGap) inDeletionGap = false;
-        break;
-      case Action::Deletion:
-        if (!inDeletionGap) {
-          inDeletionGap = true;
-          ++openingGaps;
-        }
-        ++gaps;
-        if (inInsertionGap) inInsertionGap = false;
-        break;
-      default:
-        break;
-    }
-  }
+PrintReport(const Cigar & alignment, const Sequence & s1, const Sequence & s2,
+            ScoreTable & S) {
+  size_t openingGaps = alignment.openingGaps();
+  size_t gaps = alignment.gaps();
+  size_t matches = alignment.matches();
+  size_t mismatches = alignment.mismatches();
 
-  ssize_t globalScore = S.Match * matches +
-                        S.Mismatch * mismatches +
-                        S.H * openingGaps +
-                        S.G * gaps;
+  ssize_t globalScore = AlignmentScore(alignment, s1, s2, S);
 
   size_t lengthOfAlignment = matches + mismatches + gaps;
+  // An empty local alignment has no column to take percentages of.
+  size_t percentBase = std::max<size_t>(lengthOfAlignment, 1);
   std::cout
       << "\nReport:\n"
          "\nGlobal optimal score = " << globalScore
@@ -203,20 +366,40 @@ PrintReport(std::deque<Action> & actions, ScoreTable & S) {
       << ", gaps = " << gaps
       << ", opening gaps = " << openingGaps
       << "\n\nIdentities = " << matches << "/" << lengthOfAlignment
-      << " (" << 100 * matches / lengthOfAlignment << "%)"
+      << " (" << 100 * matches / percentBase << "%)"
       << ", Gaps = " << gaps << "/" << lengthOfAlignment
-      << " (" << 100 * gaps / lengthOfAlignment << "%)"
+      << " (" << 100 * gaps / percentBase << "%)"
       << std::endl;
 }
 
 
+static void
+PrintScore(std::tuple<size_t, size_t, ssize_t> & score, bool isGlobal) {
+  size_t endI, endJ;
+  ssize_t value;
+  std::tie(endI, endJ, value) = score;
+
+  std::cout
+      << "Report:\n"
+      << "\n" << (isGlobal ? "Global" : "Local") << " optimal score = " << value
+      << "\n\nAlignment ends at: s1 = " << endI << ", s2 = " << endJ
+      << std::endl;
+}
+
 void
 SequenceAlignmentDriver::Print() {
   assert(sequences_.size() == 2);
 
   PrintScoreTable(S_);
-  PrintAlignment(sequences_[0], sequences_[1], actions_);
-  PrintReport(actions_, S_);
+
+  if (scoreOnly_) {
+    PrintSequences(sequences_[0], sequences_[1]);
+    PrintScore(score_, isGlobal_);
+    return;
+  }
+
+  PrintAlignment(sequences_[0], sequences_[1], alignment_.Actions());
+  PrintReport(alignment_, sequences_[0], sequences_[1], S_);
 }
 
 }
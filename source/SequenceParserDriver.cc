@@ -24,19 +24,35 @@ namespace cpts571 {
 
 std::vector<Sequence>
 SequenceParserDriver::Parse() {
+  if (!Run()) exit(-1);
+  return sequences_;
+}
+
+bool
+SequenceParserDriver::Parse(const std::function<void(Sequence &)> & consumer) {
+  consumer_ = consumer;
+  bool parsed = Run();
+  consumer_ = nullptr;
+  return parsed;
+}
+
+bool
+SequenceParserDriver::Run() {
   std::ifstream inputFile(inputFileName_.c_str());
   if (!inputFile.good()) {
     std::cerr << "Error opening the file" << std::endl;
-    exit(-1);
+    return false;
   }
 
   SequenceFileScanner scanner(&inputFile);
   SequenceFileParser parser(scanner, *(this));
 
-  if (parser.parse() == -1)
-    std::cerr << "Parsing failed" << std::endl;
-
-  return sequences_;
+  // A malformed record stops the parser, and the records after it are lost.
+  if (parser.parse() != 0) {
+    std::cerr << "Parsing " << inputFileName_ << " failed" << std::endl;
+    return false;
+  }
+  return true;
 }
 
 }
@@ -69,47 +69,81 @@ SuffixTree::insertSuffix(Sequence::const_iterator B, Sequence::const_iterator E,
 
 std::vector<size_t>
 SuffixTree::FindLoc(const Sequence & read) const {
-  auto itr = read.begin();
+  return std::get<0>(FindSeed(read));
+}
+
+std::tuple<std::vector<size_t>, size_t, size_t>
+SuffixTree::FindSeed(const Sequence & read) const {
+  auto begin = read.begin();
+  auto itr = begin;
   auto end = read.end();
 
   node_ptr node = root_;
   node_ptr deepestNode = root_;
+  size_t seedOffset = 0;
+  size_t seedLength = 0;
 
   assert(itr != end);
 
   while (itr != end) {
     std::tie(node, itr) = FindLoc(node, itr, end);
 
-    if (node->StringDepth() >= x_ &&
-        deepestNode->StringDepth() < node->StringDepth()) {
-      deepestNode = node;
+    // The match can continue in the middle of the arc of a child: the
+    // suffixes below the child share the whole matched string.
+    size_t length = node->StringDepth();
+    node_ptr matchNode = node;
+    if (itr != end && (matchNode = node->Child(*itr)) != nullptr) {
+      auto sItr = matchNode->BeginIncomingArcString();
+      for (auto rItr = itr; rItr != end && *sItr == *rItr; ++sItr, ++rItr)
+        ++length;
+    } else {
+      matchNode = node;
+    }
+
+    if (length >= x_ && seedLength < length) {
+      deepestNode = matchNode;
+      seedOffset = std::distance(begin, itr) - node->StringDepth();
+      seedLength = length;
+    }
+
+    if (node == root_) {
+      // Nothing matches starting from here.
+      ++itr;
+    } else if (node->SuffixLink() != nullptr) {
+      node = node->SuffixLink();
+    } else {
+      itr -= node->StringDepth() - 1;
+      node = root_;
     }
-    node = node->SuffixLink();
   }
 
-  return std::vector<size_t>(
-      &A_[deepestNode->StartLeafIndex()], &A_[deepestNode->EndLeafIndex()]);
+  if (deepestNode->StartLeafIndex() == -1)
+    return std::make_tuple(std::vector<size_t>(), 0, 0);
+
+  return std::make_tuple(
+      std::vector<size_t>(&A_[deepestNode->StartLeafIndex()],
+                          &A_[deepestNode->EndLeafIndex()] + 1),
+      seedOffset, seedLength);
 }
 
 std::tuple<SuffixTree::node_ptr, Sequence::const_iterator>
 SuffixTree::FindLoc(
     SuffixTree::node_ptr r,
     Sequence::const_iterator itr, Sequence::const_iterator end) const {
+  // The string of r is matched by the characters right before itr.
+  if (itr == end) return std::make_tuple(r, itr);
 
-  auto sItr = r->BeginIncomingArcString(), sEnd = r->EndIncomingArcString();
-  for (;sItr != sEnd && itr != end && *sItr == *itr; ++sItr, ++itr);
+  node_ptr next = r->Child(*itr);
+  if (next == nullptr) return std::make_tuple(r, itr);
 
-  if (sItr == sEnd) {
-    if (itr != end) {
-      auto nextRoot = r->operator[](*itr);
-      if (nextRoot != nullptr)
-        return FindLoc(nextRoot, itr, end);
-    }
-    return std::make_tuple(r, itr);
-  }
+  auto sItr = next->BeginIncomingArcString(), sEnd = next->EndIncomingArcString();
+  auto rItr = itr;
+  for (;sItr != sEnd && rItr != end && *sItr == *rItr; ++sItr, ++rItr);
+
+  if (sItr == sEnd)
+    return FindLoc(next, rItr, end);
 
-  itr -= std::distance(r->BeginIncomingArcString(), sItr);
-  return std::make_tuple(r->Parent(), itr);
+  return std::make_tuple(r, itr);
 }
 
 void
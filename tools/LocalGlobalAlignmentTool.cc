@@ -8,6 +8,9 @@ void ParseCmdOptions(int argc, char **argv,
 
   bool local = false;
   bool global = false;
+  bool allPairs = false;
+  bool oneVsAll = false;
+  size_t memoryBudget = 0;
 
   po::options_description description("Options");
   description.add_options()
@@ -19,7 +22,30 @@ void ParseCmdOptions(int argc, char **argv,
       ("global,g", po::bool_switch(&global)->default_value(false),
        "Flag for global alignment (Default)")
       ("config-file,c", po::value<std::string>(&CFG.CFileName),
-       "The JSON configuration file storing the score table.");
+       "The JSON configuration file storing the score table.")
+      ("memory-budget,m",
+       po::value<size_t>(&memoryBudget)->default_value(2048),
+       "Memory budget in MB for the dynamic programming table.  Alignments "
+       "exceeding it store only the traceback directions, and those "
+       "exceeding also the directions run in linear space.")
+      ("score-only", po::bool_switch(&CFG.ScoreOnly)->default_value(false),
+       "Compute only the optimal score, skipping the traceback.")
+      ("threads,t", po::value<size_t>(&CFG.Threads)->default_value(1),
+       "Number of threads filling the dynamic programming table.")
+      ("wfa", po::bool_switch(&CFG.WFA)->default_value(false),
+       "Compute the global alignment with the wavefront algorithm, in time "
+       "proportional to the length times the score: fast on similar "
+       "sequences.  Wavefronts exceeding the memory budget fall back to the "
+       "dynamic programming table.")
+      ("all-pairs", po::bool_switch(&allPairs)->default_value(false),
+       "Align every pair of sequences of the input file in parallel on the "
+       "threads, printing a summary per pair.")
+      ("one-vs-all", po::bool_switch(&oneVsAll)->default_value(false),
+       "Align the first sequence of the input file against each of the "
+       "others in parallel on the threads, printing a summary per pair.")
+      ("matrix", po::bool_switch(&CFG.Matrix)->default_value(false),
+       "Print the matrix of the scores of the pairs instead of their "
+       "summaries.");
 
   po::variables_map VM;
   try {
@@ -33,14 +59,33 @@ void ParseCmdOptions(int argc, char **argv,
 
     po::notify(VM);
 
+    CFG.MemoryBudget = memoryBudget << 20;
+
     if (local && global) {
       po::error E("Please select only one between local and global alignment");
       throw E;
+    } else if (local && CFG.WFA) {
+      po::error E("The wavefront algorithm computes only global alignments");
+      throw E;
     } else if (local) {
       CFG.Global = false;
     } else {
       CFG.Global = true;
     }
+
+    if (allPairs && oneVsAll) {
+      po::error E("Please select only one between all-pairs and one-vs-all");
+      throw E;
+    } else if (allPairs) {
+      CFG.Pairs = cpts571::AlignmentPairs::All;
+    } else if (oneVsAll) {
+      CFG.Pairs = cpts571::AlignmentPairs::OneVsAll;
+    } else if (CFG.Matrix) {
+      po::error E("The score matrix needs all-pairs or one-vs-all");
+      throw E;
+    } else {
+      CFG.Pairs = cpts571::AlignmentPairs::Single;
+    }
   } catch (po::error &e) {
     std::cerr << "Error: " << e.what() << "\n" << description << std::endl;
     exit(-1);
@@ -54,6 +99,11 @@ int main(int argc, char ** argv) {
 
   cpts571::SequenceAlignmentDriver driver(CFG);
 
+  if (CFG.Pairs != cpts571::AlignmentPairs::Single) {
+    driver.AlignPairs();
+    return 0;
+  }
+
   driver.AlignSequences();
   driver.Print();
 
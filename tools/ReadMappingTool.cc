@@ -9,10 +9,34 @@ void check_range(double v) {
     throw boost::program_options::error("The value has to be in the interval ]0;1]");
 }
 
+cpts571::AlignerKind parse_aligner(const std::string & name) {
+  if (name == "full") return cpts571::AlignerKind::Full;
+  if (name == "banded") return cpts571::AlignerKind::Banded;
+  if (name == "striped") return cpts571::AlignerKind::Striped;
+  if (name == "xdrop") return cpts571::AlignerKind::XDrop;
+  if (name == "batched") return cpts571::AlignerKind::Batched;
+  if (name == "semiglobal") return cpts571::AlignerKind::SemiGlobal;
+
+  throw boost::program_options::error("Unknown aligner " + name);
+}
+
+cpts571::OutputFormat parse_format(const std::string & name) {
+  if (name == "native") return cpts571::OutputFormat::Native;
+  if (name == "sam") return cpts571::OutputFormat::SAM;
+  if (name == "paf") return cpts571::OutputFormat::PAF;
+
+  throw boost::program_options::error("Unknown output format " + name);
+}
+
 void ParseCmdOptions(int argc, char **argv,
                      cpts571::ReadMappingDriverConfiguration &CFG) {
   namespace po = boost::program_options;
 
+  std::string aligner;
+  std::string format;
+  bool noPrefilter;
+  bool forwardOnly;
+
   po::options_description description("Options");
   description.add_options()
       ("help,h", "Print this help message")
@@ -27,7 +51,37 @@ void ParseCmdOptions(int argc, char **argv,
       (",Y", po::value<double>(&CFG.Y)->default_value(0.8)->notifier(&check_range),
        "The Y parameter ]0;1]")
       ("config-file,c", po::value<std::string>(&CFG.CFileName),
-       "The JSON configuration file storing the score table.");
+       "The JSON configuration file storing the score table.")
+      ("aligner", po::value<std::string>(&aligner)->default_value("striped"),
+       "The alignment procedure verifying the candidate locations "
+       "(full, banded, striped, xdrop, batched, semiglobal)")
+      ("band-width,w", po::value<size_t>(&CFG.BandWidth)->default_value(8),
+       "The initial half width of the band around the seed diagonal")
+      ("x-drop", po::value<ssize_t>(&CFG.XDrop)->default_value(20),
+       "The drop from the best score ending the extensions of the seed")
+      ("no-prefilter", po::bool_switch(&noPrefilter),
+       "Align every candidate location, also those whose edit distance from "
+       "the read rules out the X and Y thresholds")
+      ("max-candidates",
+       po::value<size_t>(&CFG.MaxCandidates)->default_value(64),
+       "The maximum number of windows aligned per strand of a read, keeping "
+       "those with the most seeds (0 aligns them all)")
+      ("min-quality", po::value<size_t>(&CFG.MinQuality)->default_value(0),
+       "Mask the bases of FASTQ reads below this Phred quality, cutting "
+       "them from the end of the reads (0 keeps every base)")
+      ("forward-only", po::bool_switch(&forwardOnly),
+       "Map only the reads and not their reverse complement")
+      ("threads,t", po::value<size_t>(&CFG.Threads)->default_value(1),
+       "Number of threads aligning the reads to their candidate locations.")
+      ("seed-threads", po::value<size_t>(&CFG.SeedThreads)->default_value(1),
+       "Number of threads finding the candidate locations of the reads.")
+      ("batch-size,b", po::value<size_t>(&CFG.BatchSize)->default_value(128),
+       "Number of reads passed at once between the stages of the "
+       "pipeline.")
+      ("format", po::value<std::string>(&format)->default_value("native"),
+       "The format of the mapping results (native, sam, paf)")
+      ("output,o", po::value<std::string>(&CFG.OutputFileName),
+       "The file receiving the mapping results (default standard output)");
 
   po::variables_map VM;
   try {
@@ -40,6 +94,14 @@ void ParseCmdOptions(int argc, char **argv,
     }
 
     po::notify(VM);
+
+    if (CFG.Threads == 0 || CFG.SeedThreads == 0 || CFG.BatchSize == 0)
+      throw po::error("The threads and the batch size must be positive");
+
+    CFG.Aligner = parse_aligner(aligner);
+    CFG.Format = parse_format(format);
+    CFG.Prefilter = !noPrefilter;
+    CFG.BothStrands = !forwardOnly;
   } catch (po::error &e) {
     std::cerr << "Error: " << e.what() << "\n" << description << std::endl;
     exit(-1);